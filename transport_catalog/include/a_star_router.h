@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.h"
+#include "router.h"
+
+namespace Graph {
+
+  // Point on the unit sphere. The chord between two points is never longer
+  // than the arc, and unlike acos it keeps full precision for close stops.
+  struct SpherePoint {
+    double x;
+    double y;
+    double z;
+  };
+
+  inline SpherePoint MakeSpherePoint(double latitude_rad,
+                                     double longitude_rad) {
+    return {std::cos(latitude_rad) * std::cos(longitude_rad),
+            std::cos(latitude_rad) * std::sin(longitude_rad),
+            std::sin(latitude_rad)};
+  }
+
+  inline double ChordLength(const SpherePoint& lhs, const SpherePoint& rhs) {
+    const double dx = lhs.x - rhs.x;
+    const double dy = lhs.y - rhs.y;
+    const double dz = lhs.z - rhs.z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+  }
+
+  // Bidirectional A* over vertex coordinates. The lower bound between two
+  // vertices is their chord times the smallest weight per chord unit over
+  // all edges, so it holds whatever road distances the input has. Both
+  // searches use the average of the two potentials, which keeps them
+  // consistent and lets them stop once the queue keys sum up to the best
+  // route found.
+  template <typename Weight>
+  class BidirectionalAStar : public RouterBase<Weight> {
+   private:
+    using Graph = CsrGraph<Weight>;
+
+   public:
+    BidirectionalAStar(const Graph& graph, std::vector<SpherePoint> points);
+
+    QueryStatePtr MakeQueryState() const override;
+    std::optional<Weight> FindRoute(VertexId from, VertexId to,
+                                    std::vector<EdgeId>& edges,
+                                    QueryState& state) const override;
+    // Plain forward search settling every target: with many targets
+    // there is no single one for the potentials to aim at
+    std::vector<std::optional<Weight>> BuildRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets,
+        QueryState& state) const override;
+
+   private:
+    struct SearchSide {
+      std::vector<std::optional<Weight>> distances;
+      std::vector<std::optional<EdgeId>> prev_edges;
+      std::vector<bool> settled;
+    };
+
+    // Kept between queries, only touched vertices are reset
+    struct SearchState : QueryState {
+      explicit SearchState(size_t vertex_count);
+
+      VertexId query_from = 0;
+      VertexId query_to = 0;
+      SearchSide forward;
+      SearchSide backward;
+      std::vector<std::optional<double>> potentials;
+      std::vector<VertexId> touched;
+
+      void Reset();
+    };
+
+    using QueueItem = std::pair<double, VertexId>;
+    using Queue = std::priority_queue<QueueItem,
+                                      std::vector<QueueItem>,
+                                      std::greater<QueueItem>>;
+
+    static Graph MakeBackwardGraph(const Graph& graph);
+    double MinWeightPerChord() const;
+
+    double LowerBound(VertexId from, VertexId to) const;
+    // Forward potential of the state's query, backward one is its negation
+    double Potential(VertexId vertex, SearchState& state) const;
+
+    const Graph& graph_;
+    const Graph backward_graph_;
+    const std::vector<SpherePoint> points_;
+    const double weight_per_chord_;
+  };
+
+
+  template <typename Weight>
+  BidirectionalAStar<Weight>::BidirectionalAStar(
+      const Graph& graph, std::vector<SpherePoint> points)
+      : graph_(graph),
+        backward_graph_(MakeBackwardGraph(graph)),
+        points_(std::move(points)),
+        weight_per_chord_(MinWeightPerChord()) {
+    if (points_.size() != graph.GetVertexCount()) {
+      throw std::runtime_error("A* needs a point for every vertex");
+    }
+  }
+
+  template <typename Weight>
+  BidirectionalAStar<Weight>::SearchState::SearchState(size_t vertex_count)
+      : potentials(vertex_count) {
+    for (SearchSide* side : {&forward, &backward}) {
+      side->distances.resize(vertex_count);
+      side->prev_edges.resize(vertex_count);
+      side->settled.resize(vertex_count);
+    }
+  }
+
+  template <typename Weight>
+  QueryStatePtr BidirectionalAStar<Weight>::MakeQueryState() const {
+    return std::make_unique<SearchState>(graph_.GetVertexCount());
+  }
+
+  // Same edge ids, every edge turned around
+  template <typename Weight>
+  typename BidirectionalAStar<Weight>::Graph
+  BidirectionalAStar<Weight>::MakeBackwardGraph(const Graph& graph) {
+    std::vector<Edge<Weight>> edges(graph.GetEdgeCount());
+    for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+      for (const auto& arc : graph.GetOutgoingArcs(vertex)) {
+        edges[arc.edge_id] = Edge<Weight>{arc.to, vertex, arc.weight};
+      }
+    }
+    return Graph(graph.GetVertexCount(), edges);
+  }
+
+  template <typename Weight>
+  double BidirectionalAStar<Weight>::MinWeightPerChord() const {
+    double result = std::numeric_limits<double>::infinity();
+    for (VertexId vertex = 0; vertex < graph_.GetVertexCount(); ++vertex) {
+      for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+        const double chord = ChordLength(points_[vertex], points_[arc.to]);
+        if (chord > 0) {
+          result = std::min(result, static_cast<double>(arc.weight) / chord);
+        }
+      }
+    }
+    if (std::isinf(result)) {
+      return 0;
+    }
+    // Rounding of the bound must not make it exceed the real weight
+    return result * (1 - 1e-9);
+  }
+
+  template <typename Weight>
+  double BidirectionalAStar<Weight>::LowerBound(VertexId from,
+                                                VertexId to) const {
+    return ChordLength(points_[from], points_[to]) * weight_per_chord_;
+  }
+
+  template <typename Weight>
+  double BidirectionalAStar<Weight>::Potential(VertexId vertex,
+                                               SearchState& state) const {
+    auto& potential = state.potentials[vertex];
+    if (!potential) {
+      state.touched.push_back(vertex);
+      potential = (LowerBound(vertex, state.query_to) -
+                   LowerBound(state.query_from, vertex)) / 2;
+    }
+    return *potential;
+  }
+
+  template <typename Weight>
+  void BidirectionalAStar<Weight>::SearchState::Reset() {
+    for (const VertexId v : touched) {
+      potentials[v] = std::nullopt;
+      for (SearchSide* side : {&forward, &backward}) {
+        side->distances[v] = std::nullopt;
+        side->prev_edges[v] = std::nullopt;
+        side->settled[v] = false;
+      }
+    }
+    touched.clear();
+  }
+
+  template <typename Weight>
+  std::optional<Weight>
+  BidirectionalAStar<Weight>::FindRoute(VertexId from, VertexId to,
+                                        std::vector<EdgeId>& edges,
+                                        QueryState& state) const {
+    auto& search = dynamic_cast<SearchState&>(state);
+    auto& forward = search.forward;
+    auto& backward = search.backward;
+    edges.clear();
+    search.Reset();
+    search.query_from = from;
+    search.query_to = to;
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+    if (from == to) {
+      best_weight = Weight{0};
+    }
+
+    Queue forward_queue;
+    Queue backward_queue;
+    forward.distances[from] = Weight{0};
+    backward.distances[to] = Weight{0};
+    forward_queue.push({Potential(from, search), from});
+    backward_queue.push({-Potential(to, search), to});
+
+    // One vertex of a side: settles it and relaxes its arcs,
+    // routes meeting the other side update the best one
+    auto step = [&](Queue& queue, SearchSide& side, const SearchSide& other,
+                    const Graph& graph, double potential_sign) {
+      const VertexId vertex = queue.top().second;
+      queue.pop();
+      if (side.settled[vertex]) {
+        return;
+      }
+      side.settled[vertex] = true;
+      const Weight weight = *side.distances[vertex];
+      for (const auto& arc : graph.GetOutgoingArcs(vertex)) {
+        assert(arc.weight >= 0);
+        const Weight candidate_weight = weight + arc.weight;
+        auto& distance = side.distances[arc.to];
+        if (distance && !(candidate_weight < *distance)) {
+          continue;
+        }
+        distance = candidate_weight;
+        side.prev_edges[arc.to] = arc.edge_id;
+        queue.push({candidate_weight +
+                      potential_sign * Potential(arc.to, search),
+                    arc.to});
+        if (other.distances[arc.to]) {
+          const Weight route_weight = candidate_weight + *other.distances[arc.to];
+          if (!best_weight || route_weight < *best_weight) {
+            best_weight = route_weight;
+            meeting_vertex = arc.to;
+          }
+        }
+      }
+    };
+
+    while (!forward_queue.empty() && !backward_queue.empty()) {
+      const double forward_key = forward_queue.top().first;
+      const double backward_key = backward_queue.top().first;
+      if (best_weight && forward_key + backward_key >= *best_weight) {
+        break;
+      }
+      if (forward_key <= backward_key) {
+        step(forward_queue, forward, backward, graph_, 1);
+      }
+      else {
+        step(backward_queue, backward, forward, backward_graph_, -1);
+      }
+    }
+
+    if (!best_weight) {
+      return std::nullopt;
+    }
+    for (std::optional<EdgeId> edge_id = forward.prev_edges[meeting_vertex];
+         edge_id;
+         edge_id = forward.prev_edges[graph_.GetEdge(*edge_id).from]) {
+      edges.push_back(*edge_id);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+    for (std::optional<EdgeId> edge_id = backward.prev_edges[meeting_vertex];
+         edge_id;
+         edge_id = backward.prev_edges[graph_.GetEdge(*edge_id).to]) {
+      edges.push_back(*edge_id);
+    }
+
+    return *best_weight;
+  }
+
+  template <typename Weight>
+  std::vector<std::optional<Weight>>
+  BidirectionalAStar<Weight>::BuildRouteWeights(
+      VertexId from, const std::vector<VertexId>& targets,
+      QueryState& state) const {
+    if (targets.empty()) {
+      return {};
+    }
+    auto& search = dynamic_cast<SearchState&>(state);
+    auto& forward = search.forward;
+    search.Reset();
+
+    std::unordered_set<VertexId> unsettled(targets.begin(), targets.end());
+    Queue queue;
+    forward.distances[from] = Weight{0};
+    search.touched.push_back(from);
+    queue.push({0, from});
+    while (!queue.empty()) {
+      const VertexId vertex = queue.top().second;
+      queue.pop();
+      if (forward.settled[vertex]) {
+        continue;
+      }
+      forward.settled[vertex] = true;
+      if (unsettled.erase(vertex) && unsettled.empty()) {
+        break;
+      }
+      const Weight weight = *forward.distances[vertex];
+      for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+        assert(arc.weight >= 0);
+        const Weight candidate_weight = weight + arc.weight;
+        auto& distance = forward.distances[arc.to];
+        if (distance && !(candidate_weight < *distance)) {
+          continue;
+        }
+        if (!distance) {
+          search.touched.push_back(arc.to);
+        }
+        distance = candidate_weight;
+        queue.push({static_cast<double>(candidate_weight), arc.to});
+      }
+    }
+
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+      weights.push_back(forward.distances[to]);
+    }
+    return weights;
+  }
+
+}  // namespace Graph
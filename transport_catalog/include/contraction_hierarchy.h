@@ -0,0 +1,622 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.h"
+#include "router.h"
+#include "transport_catalog.pb.h"
+
+namespace Graph {
+
+  // Contraction Hierarchies: vertices are contracted one by one in order of
+  // importance, shortcuts keep distances between the remaining ones. A query
+  // is a bidirectional Dijkstra which only goes up the hierarchy, shortcuts
+  // are unpacked back to the graph edges.
+  //
+  // Shortcut ids continue edge ids of the graph: graph.GetEdgeCount() + idx
+  template <typename Weight>
+  class ContractionHierarchy : public RouterBase<Weight> {
+   private:
+    using Graph = CsrGraph<Weight>;
+
+   public:
+    // Runs the whole preprocessing
+    explicit ContractionHierarchy(const Graph& graph);
+    ContractionHierarchy(const Graph& graph,
+                         const TCatalog::ContractionHierarchy& hierarchy);
+
+    QueryStatePtr MakeQueryState() const override;
+    std::optional<Weight> FindRoute(VertexId from, VertexId to,
+                                    std::vector<EdgeId>& edges,
+                                    QueryState& state) const override;
+    // Bucket search below with a single source, no route is unpacked
+    std::vector<std::optional<Weight>> BuildRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets,
+        QueryState& state) const override;
+    // Bucket many-to-many: one full backward upward search per target
+    // leaves (target, weight) in every vertex it reaches, then one forward
+    // upward search per source combines them with its own weights
+    std::vector<std::vector<std::optional<Weight>>> BuildRouteWeightsTable(
+        const std::vector<VertexId>& sources,
+        const std::vector<VertexId>& targets,
+        QueryState& state) const override;
+
+    TCatalog::ContractionHierarchy Serialize() const;
+
+   private:
+    struct Shortcut {
+      VertexId from;
+      VertexId to;
+      Weight weight;
+      EdgeId first;
+      EdgeId second;
+    };
+
+    struct Arc {
+      uint32_t to;
+      uint32_t id;
+      Weight weight;
+    };
+
+    // One search direction in compressed sparse row layout
+    struct SearchGraph {
+      std::vector<uint32_t> offsets;
+      std::vector<Arc> arcs;
+
+      Range<typename std::vector<Arc>::const_iterator>
+      GetArcs(VertexId vertex) const {
+        return {arcs.begin() + offsets[vertex],
+                arcs.begin() + offsets[vertex + 1]};
+      }
+    };
+
+    // Neighbour -> (weight, edge or shortcut id) of the lightest arc
+    using Neighbours = std::unordered_map<VertexId, std::pair<Weight, EdgeId>>;
+
+    // Witness searches give up after this many settled vertices and the
+    // shortcut is added just in case
+    static constexpr size_t WITNESS_SETTLE_LIMIT = 100;
+
+    // Graph of not yet contracted vertices plus witness search scratch
+    struct ContractionState {
+      std::vector<Neighbours> in;
+      std::vector<Neighbours> out;
+      std::vector<int> contracted_neighbours;
+      std::vector<std::optional<Weight>> witness_distances;
+      std::vector<VertexId> witness_touched;
+    };
+
+    void Contract();
+    std::vector<Shortcut> FindShortcuts(VertexId vertex,
+                                        ContractionState& state) const;
+    void BuildSearchGraphs();
+    static SearchGraph MakeSearchGraph(
+        size_t vertex_count,
+        const std::vector<std::pair<VertexId, Arc>>& arcs);
+    VertexId GetArcFrom(EdgeId id) const;
+    VertexId GetArcTo(EdgeId id) const;
+    void UnpackArc(EdgeId id, std::vector<EdgeId>& edges) const;
+
+    const Graph& graph_;
+    std::vector<size_t> ranks_;
+    std::vector<Shortcut> shortcuts_;
+    // Arcs to higher ranked vertices
+    SearchGraph upward_;
+    // Reversed arcs from higher ranked vertices
+    SearchGraph downward_;
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem,
+                                      std::vector<QueueItem>,
+                                      std::greater<QueueItem>>;
+
+    struct SearchSide {
+      explicit SearchSide(size_t vertex_count)
+          : distances(vertex_count), parent_arcs(vertex_count) {}
+
+      std::vector<std::optional<Weight>> distances;
+      std::vector<std::optional<EdgeId>> parent_arcs;
+      std::vector<VertexId> touched;
+
+      void Reset();
+    };
+
+    // Kept between queries, only touched vertices are reset
+    struct SearchState : QueryState {
+      explicit SearchState(size_t vertex_count)
+          : forward(vertex_count), backward(vertex_count) {}
+
+      SearchSide forward;
+      SearchSide backward;
+    };
+
+    // Whole search space of one direction, visit gets every settled
+    // vertex with its weight
+    template <typename Visit>
+    void SearchUpward(VertexId from, const SearchGraph& search_graph,
+                      SearchSide& side, Visit visit) const;
+  };
+
+
+  template <typename Weight>
+  ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph)
+      : graph_(graph) {
+    Contract();
+    BuildSearchGraphs();
+  }
+
+  template <typename Weight>
+  ContractionHierarchy<Weight>::ContractionHierarchy(
+      const Graph& graph,
+      const TCatalog::ContractionHierarchy& hierarchy)
+      : graph_(graph) {
+    if (static_cast<size_t>(hierarchy.ranks_size()) != graph.GetVertexCount()) {
+      throw std::runtime_error("Contraction hierarchy doesn't match the graph");
+    }
+    ranks_.assign(hierarchy.ranks().begin(), hierarchy.ranks().end());
+    shortcuts_.reserve(hierarchy.shortcuts_size());
+    for (const auto& s : hierarchy.shortcuts()) {
+      shortcuts_.push_back(Shortcut{s.id_from(), s.id_to(),
+                                    static_cast<Weight>(s.w()),
+                                    s.first(), s.second()});
+    }
+    BuildSearchGraphs();
+  }
+
+  template <typename Weight>
+  TCatalog::ContractionHierarchy
+  ContractionHierarchy<Weight>::Serialize() const {
+    TCatalog::ContractionHierarchy hierarchy;
+    for (const size_t rank : ranks_) {
+      hierarchy.add_ranks(rank);
+    }
+    for (const auto& shortcut : shortcuts_) {
+      TCatalog::Shortcut& s = *hierarchy.add_shortcuts();
+      s.set_id_from(shortcut.from);
+      s.set_id_to(shortcut.to);
+      s.set_w(static_cast<double>(shortcut.weight));
+      s.set_first(shortcut.first);
+      s.set_second(shortcut.second);
+    }
+    return hierarchy;
+  }
+
+  template <typename Weight>
+  std::vector<typename ContractionHierarchy<Weight>::Shortcut>
+  ContractionHierarchy<Weight>::FindShortcuts(VertexId vertex,
+                                              ContractionState& state) const {
+    std::vector<Shortcut> shortcuts;
+    const Neighbours& in = state.in[vertex];
+    const Neighbours& out = state.out[vertex];
+    if (in.empty() || out.empty()) {
+      return shortcuts;
+    }
+    Weight max_out_weight{0};
+    for (const auto& [to, arc] : out) {
+      max_out_weight = std::max(max_out_weight, arc.first);
+    }
+
+    auto& distances = state.witness_distances;
+    for (const auto& [from, in_arc] : in) {
+      // Dijkstra from `from` which avoids `vertex` and looks no further than
+      // the longest path through it or the moment all targets are settled
+      const Weight limit = in_arc.first + max_out_weight;
+      size_t targets_left = out.size() - out.count(from);
+      Queue queue;
+      distances[from] = Weight{0};
+      state.witness_touched.push_back(from);
+      queue.push({Weight{0}, from});
+      size_t settled = 0;
+      while (!queue.empty() && settled < WITNESS_SETTLE_LIMIT &&
+             targets_left > 0) {
+        const auto [weight, v] = queue.top();
+        queue.pop();
+        if (weight > *distances[v]) {
+          continue;
+        }
+        if (weight > limit) {
+          break;
+        }
+        ++settled;
+        if (v != from && out.count(v)) {
+          --targets_left;
+        }
+        for (const auto& [to, arc] : state.out[v]) {
+          if (to == vertex) {
+            continue;
+          }
+          const Weight candidate_weight = weight + arc.first;
+          auto& distance = distances[to];
+          if (!distance || candidate_weight < *distance) {
+            if (!distance) {
+              state.witness_touched.push_back(to);
+            }
+            distance = candidate_weight;
+            queue.push({candidate_weight, to});
+          }
+        }
+      }
+
+      for (const auto& [to, out_arc] : out) {
+        if (to == from) {
+          continue;
+        }
+        const Weight through_weight = in_arc.first + out_arc.first;
+        if (distances[to] && *distances[to] <= through_weight) {
+          continue;
+        }
+        shortcuts.push_back(Shortcut{from, to, through_weight,
+                                     in_arc.second, out_arc.second});
+      }
+
+      for (const VertexId v : state.witness_touched) {
+        distances[v] = std::nullopt;
+      }
+      state.witness_touched.clear();
+    }
+    return shortcuts;
+  }
+
+  template <typename Weight>
+  void ContractionHierarchy<Weight>::Contract() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const EdgeId edge_count = graph_.GetEdgeCount();
+    ContractionState state;
+    state.in.resize(vertex_count);
+    state.out.resize(vertex_count);
+    state.contracted_neighbours.assign(vertex_count, 0);
+    state.witness_distances.assign(vertex_count, std::nullopt);
+    auto& in = state.in;
+    auto& out = state.out;
+
+    // Only the lightest of parallel edges matters, the first one wins ties
+    for (VertexId from = 0; from < vertex_count; ++from) {
+      for (const auto& arc : graph_.GetOutgoingArcs(from)) {
+        assert(arc.weight >= 0);
+        if (arc.to == from) {
+          continue;
+        }
+        auto it = out[from].find(arc.to);
+        if (it == out[from].end() || arc.weight < it->second.first) {
+          out[from][arc.to] = {arc.weight, arc.edge_id};
+          in[arc.to][from] = {arc.weight, arc.edge_id};
+        }
+      }
+    }
+
+    // Edge difference plus the number of already contracted neighbours,
+    // which keeps contraction spread evenly over the graph
+    auto priority = [&state](VertexId v, size_t shortcut_count) {
+      return static_cast<int>(shortcut_count) -
+             static_cast<int>(state.in[v].size() + state.out[v].size()) +
+             state.contracted_neighbours[v];
+    };
+
+    using OrderItem = std::pair<int, VertexId>;
+    std::priority_queue<OrderItem,
+                        std::vector<OrderItem>,
+                        std::greater<OrderItem>> order;
+    for (VertexId v = 0; v < vertex_count; ++v) {
+      order.push({priority(v, FindShortcuts(v, state).size()), v});
+    }
+
+    ranks_.assign(vertex_count, 0);
+    std::vector<bool> contracted(vertex_count, false);
+    size_t next_rank = 0;
+    while (!order.empty()) {
+      const VertexId vertex = order.top().second;
+      order.pop();
+      if (contracted[vertex]) {
+        continue;
+      }
+      // Lazy update: priorities of the neighbours are recomputed only when
+      // they reach the top of the queue
+      std::vector<Shortcut> shortcuts = FindShortcuts(vertex, state);
+      const int vertex_priority = priority(vertex, shortcuts.size());
+      if (!order.empty() && vertex_priority > order.top().first) {
+        order.push({vertex_priority, vertex});
+        continue;
+      }
+
+      ranks_[vertex] = next_rank++;
+      contracted[vertex] = true;
+      for (auto& shortcut : shortcuts) {
+        auto it = out[shortcut.from].find(shortcut.to);
+        if (it != out[shortcut.from].end() &&
+            it->second.first <= shortcut.weight) {
+          continue;
+        }
+        const EdgeId id = edge_count + shortcuts_.size();
+        out[shortcut.from][shortcut.to] = {shortcut.weight, id};
+        in[shortcut.to][shortcut.from] = {shortcut.weight, id};
+        shortcuts_.push_back(shortcut);
+      }
+      // Contracted vertices leave the remaining graph
+      for (const auto& [from, arc] : in[vertex]) {
+        out[from].erase(vertex);
+        ++state.contracted_neighbours[from];
+      }
+      for (const auto& [to, arc] : out[vertex]) {
+        in[to].erase(vertex);
+        ++state.contracted_neighbours[to];
+      }
+      in[vertex].clear();
+      out[vertex].clear();
+    }
+  }
+
+  template <typename Weight>
+  void ContractionHierarchy<Weight>::BuildSearchGraphs() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const EdgeId edge_count = graph_.GetEdgeCount();
+    std::vector<std::pair<VertexId, Arc>> upward_arcs, downward_arcs;
+    auto add_arc = [&](VertexId from, VertexId to, Weight w, EdgeId id) {
+      if (from == to) {
+        return;
+      }
+      const uint32_t arc_id = static_cast<uint32_t>(id);
+      if (ranks_[from] < ranks_[to]) {
+        upward_arcs.push_back({from, Arc{static_cast<uint32_t>(to),
+                                         arc_id, w}});
+      }
+      else {
+        downward_arcs.push_back({to, Arc{static_cast<uint32_t>(from),
+                                         arc_id, w}});
+      }
+    };
+    for (VertexId from = 0; from < vertex_count; ++from) {
+      for (const auto& arc : graph_.GetOutgoingArcs(from)) {
+        add_arc(from, arc.to, arc.weight, arc.edge_id);
+      }
+    }
+    for (size_t idx = 0; idx < shortcuts_.size(); ++idx) {
+      const auto& shortcut = shortcuts_[idx];
+      add_arc(shortcut.from, shortcut.to, shortcut.weight, edge_count + idx);
+    }
+    upward_ = MakeSearchGraph(vertex_count, upward_arcs);
+    downward_ = MakeSearchGraph(vertex_count, downward_arcs);
+  }
+
+  template <typename Weight>
+  QueryStatePtr ContractionHierarchy<Weight>::MakeQueryState() const {
+    return std::make_unique<SearchState>(graph_.GetVertexCount());
+  }
+
+  template <typename Weight>
+  typename ContractionHierarchy<Weight>::SearchGraph
+  ContractionHierarchy<Weight>::MakeSearchGraph(
+      size_t vertex_count,
+      const std::vector<std::pair<VertexId, Arc>>& arcs) {
+    SearchGraph search_graph;
+    search_graph.offsets.assign(vertex_count + 1, 0);
+    search_graph.arcs.resize(arcs.size());
+    for (const auto& [vertex, arc] : arcs) {
+      ++search_graph.offsets[vertex + 1];
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+      search_graph.offsets[v + 1] += search_graph.offsets[v];
+    }
+    std::vector<uint32_t> next_arc(search_graph.offsets.begin(),
+                                   search_graph.offsets.end() - 1);
+    for (const auto& [vertex, arc] : arcs) {
+      search_graph.arcs[next_arc[vertex]++] = arc;
+    }
+    return search_graph;
+  }
+
+  template <typename Weight>
+  void ContractionHierarchy<Weight>::SearchSide::Reset() {
+    for (const VertexId v : touched) {
+      distances[v] = std::nullopt;
+      parent_arcs[v] = std::nullopt;
+    }
+    touched.clear();
+  }
+
+  template <typename Weight>
+  VertexId ContractionHierarchy<Weight>::GetArcFrom(EdgeId id) const {
+    const EdgeId edge_count = graph_.GetEdgeCount();
+    return id < edge_count ? graph_.GetEdge(id).from
+                           : shortcuts_[id - edge_count].from;
+  }
+
+  template <typename Weight>
+  VertexId ContractionHierarchy<Weight>::GetArcTo(EdgeId id) const {
+    const EdgeId edge_count = graph_.GetEdgeCount();
+    return id < edge_count ? graph_.GetEdge(id).to
+                           : shortcuts_[id - edge_count].to;
+  }
+
+  template <typename Weight>
+  void ContractionHierarchy<Weight>::UnpackArc(EdgeId id,
+                                               std::vector<EdgeId>& edges)
+                                               const {
+    const EdgeId edge_count = graph_.GetEdgeCount();
+    if (id < edge_count) {
+      edges.push_back(id);
+      return;
+    }
+    const auto& shortcut = shortcuts_[id - edge_count];
+    UnpackArc(shortcut.first, edges);
+    UnpackArc(shortcut.second, edges);
+  }
+
+  template <typename Weight>
+  std::optional<Weight>
+  ContractionHierarchy<Weight>::FindRoute(VertexId from, VertexId to,
+                                          std::vector<EdgeId>& edges,
+                                          QueryState& state) const {
+    auto& search = dynamic_cast<SearchState&>(state);
+    auto& forward = search.forward;
+    auto& backward = search.backward;
+    edges.clear();
+    forward.Reset();
+    backward.Reset();
+
+    Queue forward_queue, backward_queue;
+    forward.distances[from] = Weight{0};
+    forward.touched.push_back(from);
+    forward_queue.push({Weight{0}, from});
+    backward.distances[to] = Weight{0};
+    backward.touched.push_back(to);
+    backward_queue.push({Weight{0}, to});
+
+    std::optional<Weight> best;
+    std::optional<VertexId> meeting_vertex;
+    auto step = [&best, &meeting_vertex](Queue& queue,
+                                         SearchSide& side,
+                                         const SearchSide& other,
+                                         const SearchGraph& search_graph) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (weight > *side.distances[vertex]) {
+        return;
+      }
+      if (other.distances[vertex]) {
+        const Weight through_weight = weight + *other.distances[vertex];
+        if (!best || through_weight < *best) {
+          best = through_weight;
+          meeting_vertex = vertex;
+        }
+      }
+      for (const Arc& arc : search_graph.GetArcs(vertex)) {
+        const Weight candidate_weight = weight + arc.weight;
+        auto& distance = side.distances[arc.to];
+        if (!distance || candidate_weight < *distance) {
+          if (!distance) {
+            side.touched.push_back(arc.to);
+          }
+          distance = candidate_weight;
+          side.parent_arcs[arc.to] = arc.id;
+          queue.push({candidate_weight, arc.to});
+        }
+      }
+    };
+
+    // Each direction stops once it can't improve the best meeting point
+    while (true) {
+      const bool forward_active = !forward_queue.empty() &&
+        (!best || forward_queue.top().first < *best);
+      const bool backward_active = !backward_queue.empty() &&
+        (!best || backward_queue.top().first < *best);
+      if (!forward_active && !backward_active) {
+        break;
+      }
+      if (forward_active &&
+          (!backward_active ||
+           forward_queue.top().first <= backward_queue.top().first)) {
+        step(forward_queue, forward, backward, upward_);
+      }
+      else {
+        step(backward_queue, backward, forward, downward_);
+      }
+    }
+
+    if (!best) {
+      return std::nullopt;
+    }
+
+    std::vector<EdgeId> up_arcs;
+    for (VertexId v = *meeting_vertex; forward.parent_arcs[v];
+         v = GetArcFrom(*forward.parent_arcs[v])) {
+      up_arcs.push_back(*forward.parent_arcs[v]);
+    }
+    std::reverse(std::begin(up_arcs), std::end(up_arcs));
+    for (VertexId v = *meeting_vertex; backward.parent_arcs[v];
+         v = GetArcTo(*backward.parent_arcs[v])) {
+      up_arcs.push_back(*backward.parent_arcs[v]);
+    }
+
+    for (const EdgeId id : up_arcs) {
+      UnpackArc(id, edges);
+    }
+    return *best;
+  }
+
+  template <typename Weight>
+  template <typename Visit>
+  void ContractionHierarchy<Weight>::SearchUpward(
+      VertexId from, const SearchGraph& search_graph,
+      SearchSide& side, Visit visit) const {
+    side.Reset();
+    Queue queue;
+    side.distances[from] = Weight{0};
+    side.touched.push_back(from);
+    queue.push({Weight{0}, from});
+    while (!queue.empty()) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (weight > *side.distances[vertex]) {
+        continue;
+      }
+      visit(vertex, weight);
+      for (const Arc& arc : search_graph.GetArcs(vertex)) {
+        const Weight candidate_weight = weight + arc.weight;
+        auto& distance = side.distances[arc.to];
+        if (!distance || candidate_weight < *distance) {
+          if (!distance) {
+            side.touched.push_back(arc.to);
+          }
+          distance = candidate_weight;
+          queue.push({candidate_weight, arc.to});
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  std::vector<std::optional<Weight>>
+  ContractionHierarchy<Weight>::BuildRouteWeights(
+      VertexId from, const std::vector<VertexId>& targets,
+      QueryState& state) const {
+    return std::move(BuildRouteWeightsTable({from}, targets, state).front());
+  }
+
+  template <typename Weight>
+  std::vector<std::vector<std::optional<Weight>>>
+  ContractionHierarchy<Weight>::BuildRouteWeightsTable(
+      const std::vector<VertexId>& sources,
+      const std::vector<VertexId>& targets,
+      QueryState& state) const {
+    auto& search = dynamic_cast<SearchState&>(state);
+    std::unordered_map<VertexId,
+                       std::vector<std::pair<size_t, Weight>>> buckets;
+    for (size_t target_idx = 0; target_idx < targets.size(); ++target_idx) {
+      SearchUpward(targets[target_idx], downward_, search.backward,
+                   [&](VertexId vertex, Weight weight) {
+                     buckets[vertex].emplace_back(target_idx, weight);
+                   });
+    }
+
+    std::vector<std::vector<std::optional<Weight>>> table;
+    table.reserve(sources.size());
+    for (const VertexId from : sources) {
+      std::vector<std::optional<Weight>> weights(targets.size());
+      auto scan_bucket = [&](VertexId vertex, Weight weight) {
+        const auto it = buckets.find(vertex);
+        if (it == buckets.end()) {
+          return;
+        }
+        for (const auto& [target_idx, target_weight] : it->second) {
+          auto& route_weight = weights[target_idx];
+          if (!route_weight || weight + target_weight < *route_weight) {
+            route_weight = weight + target_weight;
+          }
+        }
+      };
+      SearchUpward(from, upward_, search.forward, scan_bucket);
+      table.push_back(std::move(weights));
+    }
+    return table;
+  }
+
+}  // namespace Graph
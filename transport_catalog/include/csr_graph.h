@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "graph.h"
+
+namespace Graph {
+
+  // Frozen graph in compressed sparse row layout: outgoing arcs of a vertex
+  // lie contiguously and vertices follow each other. Arcs of one vertex keep
+  // the order of their edge ids, edge ids stay the same as in the source
+  // edge list so anything stored per edge id remains valid.
+  template <typename Weight>
+  class CsrGraph {
+   public:
+    struct Arc {
+      uint32_t to;
+      uint32_t edge_id;
+      Weight weight;
+    };
+
+   private:
+    using Arcs = std::vector<Arc>;
+    using ArcsRange = Range<typename Arcs::const_iterator>;
+
+   public:
+    // Ends of every edge must be less than vertex_count
+    CsrGraph(size_t vertex_count, const std::vector<Edge<Weight>>& edges);
+
+    size_t GetVertexCount() const;
+    size_t GetEdgeCount() const;
+    Edge<Weight> GetEdge(EdgeId edge_id) const;
+    ArcsRange GetOutgoingArcs(VertexId vertex) const;
+
+   private:
+    void CheckLimits(size_t vertex_count, size_t edge_count) const;
+
+    std::vector<uint32_t> offsets_;
+    Arcs arcs_;
+    std::vector<uint32_t> arc_of_edge_;
+    // Source of every edge, arcs only know their heads
+    std::vector<uint32_t> edge_from_;
+  };
+
+
+  template <typename Weight>
+  CsrGraph<Weight>::CsrGraph(size_t vertex_count,
+                             const std::vector<Edge<Weight>>& edges)
+      : offsets_(vertex_count + 1, 0),
+        arcs_(edges.size()),
+        arc_of_edge_(edges.size()),
+        edge_from_(edges.size()) {
+    CheckLimits(vertex_count, edges.size());
+    // Counting sort by source, stable in edge ids
+    for (const auto& edge : edges) {
+      if (edge.from >= vertex_count || edge.to >= vertex_count) {
+        throw std::runtime_error("Graph edge ends out of its vertices");
+      }
+      ++offsets_[edge.from + 1];
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+      offsets_[v + 1] += offsets_[v];
+    }
+    std::vector<uint32_t> next_arc(offsets_.begin(), offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < edges.size(); ++edge_id) {
+      const auto& edge = edges[edge_id];
+      const uint32_t arc_idx = next_arc[edge.from]++;
+      arcs_[arc_idx] = Arc{static_cast<uint32_t>(edge.to),
+                           static_cast<uint32_t>(edge_id),
+                           edge.weight};
+      arc_of_edge_[edge_id] = arc_idx;
+      edge_from_[edge_id] = static_cast<uint32_t>(edge.from);
+    }
+  }
+
+  template <typename Weight>
+  void CsrGraph<Weight>::CheckLimits(size_t vertex_count,
+                                     size_t edge_count) const {
+    if (vertex_count >= std::numeric_limits<uint32_t>::max() ||
+        edge_count >= std::numeric_limits<uint32_t>::max()) {
+      throw std::runtime_error("Graph is too large for 32-bit ids");
+    }
+  }
+
+  template <typename Weight>
+  size_t CsrGraph<Weight>::GetVertexCount() const {
+    return offsets_.size() - 1;
+  }
+
+  template <typename Weight>
+  size_t CsrGraph<Weight>::GetEdgeCount() const {
+    return arcs_.size();
+  }
+
+  template <typename Weight>
+  Edge<Weight> CsrGraph<Weight>::GetEdge(EdgeId edge_id) const {
+    const Arc& arc = arcs_[arc_of_edge_[edge_id]];
+    return Edge<Weight>{edge_from_[edge_id], arc.to, arc.weight};
+  }
+
+  template <typename Weight>
+  typename CsrGraph<Weight>::ArcsRange
+  CsrGraph<Weight>::GetOutgoingArcs(VertexId vertex) const {
+    return {arcs_.begin() + offsets_[vertex],
+            arcs_.begin() + offsets_[vertex + 1]};
+  }
+
+}  // namespace Graph
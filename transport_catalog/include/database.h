@@ -11,6 +11,7 @@
 
 #include "bus.h"
 #include "json.h"
+#include "lru_cache.h"
 #include "request.h"
 #include "stop.h"
 #include "transport_router.h"
@@ -35,6 +36,13 @@ struct BaseInputStruct {
 struct StatInputStruct {
   std::vector<RequestPtr> queries;
   SerializationSettingsRequestPtr serialization_settings;
+  // Optional, replaces wait time and velocities of the base
+  RoutingSettingsRequestPtr routing_settings;
+};
+
+struct UpdateInputStruct {
+  std::vector<RequestPtr> updates;
+  SerializationSettingsRequestPtr serialization_settings;
 };
 
 struct NameSvgItem {
@@ -51,19 +59,47 @@ struct MapItem {
 
 std::string GetCompanyMainName(const Company& company);
 
+// Router settings as the base stores them
+TCatalog::RouterSettings SerializeRouterSettings(const RouterSettings& rs);
+RouterSettings
+DeserializeRouterSettings(const TCatalog::RouterSettings& router_s);
+
+struct RouteCacheKeyHash {
+  size_t operator()(const std::pair<size_t, size_t>& key) const {
+    return key.first * 1'000'003 + key.second;
+  }
+};
+
+// Answers to Route queries without request ids, keyed by stop vertex ids
+using RouteCache = LruCache<std::pair<size_t, size_t>,
+                            std::map<std::string, Json::Node>,
+                            RouteCacheKeyHash>;
+
 class Database {
  public:
   explicit Database(BaseInputStruct& db_settings);
-  explicit Database(SerializationSettingsRequestPtr r);
+  // Routing settings, if given, re-customize the router of the base
+  explicit Database(SerializationSettingsRequestPtr r,
+                    RoutingSettingsRequestPtr routing_settings = nullptr);
+  // Loads the base and appends new stops and buses to it
+  Database(SerializationSettingsRequestPtr r, std::vector<RequestPtr> updates);
   void SaveToFile();
   std::vector<Response> ProcessQueries(const std::vector<RequestPtr>& queries);
+  const RouteCache& GetRouteCache() const { return route_cache_; }
 
  private:
   void SerializeDatabase();
-  void DeserializeDatabase(SerializationSettingsRequestPtr r);
+  void DeserializeDatabase(SerializationSettingsRequestPtr r,
+                           RoutingSettingsRequestPtr routing_settings);
+  void DeserializeCatalog(const TCatalog::TransportCatalog& catalog);
+  void ExtendDatabase(SerializationSettingsRequestPtr r,
+                      std::vector<RequestPtr> updates);
 
   void UpdateSettings(RoutingSettingsRequestPtr request);
   void UpdateDatabase(std::vector<RequestPtr> requests);
+  void AppendToDatabase(std::vector<RequestPtr> requests,
+                        std::vector<std::string>& new_stops,
+                        std::map<std::string, Bus>& new_buses);
   void EvaluateRouteLengths();
   void InitRenderSettings(RenderSettingsRequestPtr request);
   void UpdateRenderSettings();
@@ -128,6 +164,7 @@ class Database {
   std::map<std::string, std::set<std::string>> stops_neighbours_;
   RouterSettings router_settings_;
   TransportRouterPtr trouter_;
+  RouteCache route_cache_;
   MapSettings map_settings_;
   std::string output_file_;
 
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.h"
+#include "router.h"
+
+namespace Graph {
+
+  // Single-source router: no precomputation, every query runs Dijkstra
+  // with a binary heap and stops as soon as the target vertex is settled
+  template <typename Weight>
+  class DijkstraRouter : public RouterBase<Weight> {
+   private:
+    using Graph = CsrGraph<Weight>;
+
+   public:
+    explicit DijkstraRouter(const Graph& graph);
+
+    QueryStatePtr MakeQueryState() const override;
+    std::optional<Weight> FindRoute(VertexId from, VertexId to,
+                                    std::vector<EdgeId>& edges,
+                                    QueryState& state) const override;
+    // One search settling every target
+    std::vector<std::optional<Weight>> BuildRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets,
+        QueryState& state) const override;
+    // Bounded search: vertices with route weight up to limit, in the
+    // order they are settled, nothing beyond the limit is expanded
+    std::vector<std::pair<VertexId, Weight>> FindVerticesWithin(
+        VertexId from, Weight limit, QueryState& state) const;
+
+   private:
+    const Graph& graph_;
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem,
+                                      std::vector<QueueItem>,
+                                      std::greater<QueueItem>>;
+
+    // Kept between queries, only touched vertices are reset
+    struct SearchState : QueryState {
+      explicit SearchState(size_t vertex_count)
+          : distances(vertex_count), prev_edges(vertex_count) {}
+
+      std::vector<std::optional<Weight>> distances;
+      std::vector<std::optional<EdgeId>> prev_edges;
+      std::vector<VertexId> touched;
+
+      void Reset();
+    };
+
+    // Settles vertices in order until is_done returns true for one of them
+    template <typename IsDone>
+    void Search(VertexId from, SearchState& state, IsDone is_done) const;
+  };
+
+
+  template <typename Weight>
+  DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+      : graph_(graph) {}
+
+  template <typename Weight>
+  QueryStatePtr DijkstraRouter<Weight>::MakeQueryState() const {
+    return std::make_unique<SearchState>(graph_.GetVertexCount());
+  }
+
+  template <typename Weight>
+  void DijkstraRouter<Weight>::SearchState::Reset() {
+    for (const VertexId v : touched) {
+      distances[v] = std::nullopt;
+      prev_edges[v] = std::nullopt;
+    }
+    touched.clear();
+  }
+
+  template <typename Weight>
+  template <typename IsDone>
+  void DijkstraRouter<Weight>::Search(VertexId from, SearchState& state,
+                                      IsDone is_done) const {
+    state.Reset();
+    auto& distances = state.distances;
+
+    Queue queue;
+    distances[from] = Weight{0};
+    state.touched.push_back(from);
+    queue.push({Weight{0}, from});
+    while (!queue.empty()) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (weight > *distances[vertex]) {
+        continue;
+      }
+      if (is_done(vertex)) {
+        break;
+      }
+      for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+        assert(arc.weight >= 0);
+        const Weight candidate_weight = weight + arc.weight;
+        auto& distance = distances[arc.to];
+        if (!distance || candidate_weight < *distance) {
+          if (!distance) {
+            state.touched.push_back(arc.to);
+          }
+          distance = candidate_weight;
+          state.prev_edges[arc.to] = arc.edge_id;
+          queue.push({candidate_weight, arc.to});
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  std::optional<Weight>
+  DijkstraRouter<Weight>::FindRoute(VertexId from, VertexId to,
+                                    std::vector<EdgeId>& edges,
+                                    QueryState& state) const {
+    auto& search = dynamic_cast<SearchState&>(state);
+    edges.clear();
+    Search(from, search, [to](VertexId vertex) { return vertex == to; });
+
+    if (!search.distances[to]) {
+      return std::nullopt;
+    }
+    for (std::optional<EdgeId> edge_id = search.prev_edges[to];
+         edge_id;
+         edge_id = search.prev_edges[graph_.GetEdge(*edge_id).from]) {
+      edges.push_back(*edge_id);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+
+    return *search.distances[to];
+  }
+
+  template <typename Weight>
+  std::vector<std::optional<Weight>>
+  DijkstraRouter<Weight>::BuildRouteWeights(
+      VertexId from, const std::vector<VertexId>& targets,
+      QueryState& state) const {
+    if (targets.empty()) {
+      return {};
+    }
+    auto& search = dynamic_cast<SearchState&>(state);
+    std::unordered_set<VertexId> unsettled(targets.begin(), targets.end());
+    Search(from, search, [&unsettled](VertexId vertex) {
+      return unsettled.erase(vertex) && unsettled.empty();
+    });
+
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+      weights.push_back(search.distances[to]);
+    }
+    return weights;
+  }
+
+  template <typename Weight>
+  std::vector<std::pair<VertexId, Weight>>
+  DijkstraRouter<Weight>::FindVerticesWithin(VertexId from, Weight limit,
+                                             QueryState& state) const {
+    auto& search = dynamic_cast<SearchState&>(state);
+    std::vector<std::pair<VertexId, Weight>> vertices;
+    Search(from, search, [&search, limit, &vertices](VertexId vertex) {
+      const Weight weight = *search.distances[vertex];
+      if (weight > limit) {
+        return true;
+      }
+      vertices.emplace_back(vertex, weight);
+      return false;
+    });
+    return vertices;
+  }
+
+}  // namespace Graph
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.h"
+#include "router.h"
+#include "transport_catalog.pb.h"
+
+namespace Graph {
+
+  // Hub labeling built by pruned landmark labeling. Every vertex keeps an
+  // out label (hubs it reaches, with weights) and an in label (hubs that
+  // reach it), so the route weight of a pair is the best hub both labels
+  // share: one merge of two lists sorted by hub rank. Hubs are taken by
+  // degree, a Dijkstra from each hub skips vertices whose route the labels
+  // of earlier hubs already cover.
+  //
+  // Every entry keeps the edge leading along its route towards the hub, the
+  // vertex at the other end of it has an entry of the same hub, so routes
+  // are restored label by label without any search.
+  template <typename Weight>
+  class HubLabeling : public RouterBase<Weight> {
+   private:
+    using Graph = CsrGraph<Weight>;
+
+   public:
+    // Runs the whole preprocessing
+    explicit HubLabeling(const Graph& graph);
+    HubLabeling(const Graph& graph, const TCatalog::HubLabels& labels);
+
+    std::optional<Weight> FindRoute(VertexId from, VertexId to,
+                                    std::vector<EdgeId>& edges,
+                                    QueryState& state) const override;
+    std::vector<std::optional<Weight>> BuildRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets,
+        QueryState& state) const override;
+
+    TCatalog::HubLabels Serialize() const;
+
+   private:
+    static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+
+    struct LabelEntry {
+      uint32_t hub_rank;
+      Weight weight;
+      // First edge from the vertex to the hub in out labels, last edge from
+      // the hub to the vertex in in labels, NO_EDGE at the hub itself
+      uint32_t edge;
+    };
+
+    // Labels of all vertices in compressed sparse row layout
+    struct Labels {
+      std::vector<uint32_t> offsets;
+      std::vector<LabelEntry> entries;
+
+      Range<typename std::vector<LabelEntry>::const_iterator>
+      GetLabel(VertexId vertex) const {
+        return {entries.begin() + offsets[vertex],
+                entries.begin() + offsets[vertex + 1]};
+      }
+      const LabelEntry& FindEntry(VertexId vertex, uint32_t hub_rank) const;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem,
+                                      std::vector<QueueItem>,
+                                      std::greater<QueueItem>>;
+
+    static Graph MakeBackwardGraph(const Graph& graph);
+    static Labels MakeLabels(std::vector<std::vector<LabelEntry>> labels);
+    static Labels ReadLabels(const TCatalog::HubLabelSet& set,
+                             size_t vertex_count);
+    static void WriteLabels(const Labels& labels, TCatalog::HubLabelSet& set);
+
+    void BuildLabels();
+    // Best hub of the pair: its rank and the route weight through it
+    std::optional<std::pair<uint32_t, Weight>>
+    FindHub(VertexId from, VertexId to) const;
+
+    const Graph& graph_;
+    Labels out_labels_;
+    Labels in_labels_;
+  };
+
+
+  template <typename Weight>
+  HubLabeling<Weight>::HubLabeling(const Graph& graph)
+      : graph_(graph) {
+    BuildLabels();
+  }
+
+  template <typename Weight>
+  HubLabeling<Weight>::HubLabeling(const Graph& graph,
+                                   const TCatalog::HubLabels& labels)
+      : graph_(graph),
+        out_labels_(ReadLabels(labels.out_labels(), graph.GetVertexCount())),
+        in_labels_(ReadLabels(labels.in_labels(), graph.GetVertexCount())) {}
+
+  // Same edge ids, every edge turned around
+  template <typename Weight>
+  typename HubLabeling<Weight>::Graph
+  HubLabeling<Weight>::MakeBackwardGraph(const Graph& graph) {
+    std::vector<Edge<Weight>> edges(graph.GetEdgeCount());
+    for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+      for (const auto& arc : graph.GetOutgoingArcs(vertex)) {
+        edges[arc.edge_id] = Edge<Weight>{arc.to, vertex, arc.weight};
+      }
+    }
+    return Graph(graph.GetVertexCount(), edges);
+  }
+
+  template <typename Weight>
+  void HubLabeling<Weight>::BuildLabels() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const Graph backward_graph = MakeBackwardGraph(graph_);
+
+    // Vertices with more arcs lie on more routes and go first
+    std::vector<size_t> degrees(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      const auto out_arcs = graph_.GetOutgoingArcs(vertex);
+      const auto in_arcs = backward_graph.GetOutgoingArcs(vertex);
+      degrees[vertex] = (out_arcs.end() - out_arcs.begin()) +
+                        (in_arcs.end() - in_arcs.begin());
+    }
+    std::vector<VertexId> hubs(vertex_count);
+    std::iota(hubs.begin(), hubs.end(), 0);
+    std::stable_sort(hubs.begin(), hubs.end(),
+                     [&degrees](VertexId lhs, VertexId rhs) {
+                       return degrees[lhs] > degrees[rhs];
+                     });
+
+    std::vector<std::vector<LabelEntry>> out_labels(vertex_count);
+    std::vector<std::vector<LabelEntry>> in_labels(vertex_count);
+    // Label of the current hub spread by hub rank, so covering a vertex
+    // is checked in the length of its own label
+    std::vector<std::optional<Weight>> hub_weights(vertex_count);
+    std::vector<std::optional<Weight>> distances(vertex_count);
+    std::vector<uint32_t> edges(vertex_count, NO_EDGE);
+    std::vector<VertexId> touched;
+
+    // Pruned Dijkstra from the hub over graph, labels of settled vertices
+    // get the hub unless hub_label and their own labels already give a
+    // route as good
+    auto search = [&](uint32_t hub_rank, const Graph& graph,
+                      const std::vector<LabelEntry>& hub_label,
+                      std::vector<std::vector<LabelEntry>>& labels) {
+      const VertexId hub = hubs[hub_rank];
+      for (const auto& entry : hub_label) {
+        hub_weights[entry.hub_rank] = entry.weight;
+      }
+      Queue queue;
+      distances[hub] = Weight{0};
+      touched.push_back(hub);
+      queue.push({Weight{0}, hub});
+      while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > *distances[vertex]) {
+          continue;
+        }
+        const bool covered = std::any_of(
+            labels[vertex].begin(), labels[vertex].end(),
+            [&](const LabelEntry& entry) {
+              return hub_weights[entry.hub_rank] &&
+                     *hub_weights[entry.hub_rank] + entry.weight <= weight;
+            });
+        if (covered) {
+          continue;
+        }
+        labels[vertex].push_back(LabelEntry{hub_rank, weight, edges[vertex]});
+        for (const auto& arc : graph.GetOutgoingArcs(vertex)) {
+          assert(arc.weight >= 0);
+          const Weight candidate_weight = weight + arc.weight;
+          auto& distance = distances[arc.to];
+          if (!distance || candidate_weight < *distance) {
+            if (!distance) {
+              touched.push_back(arc.to);
+            }
+            distance = candidate_weight;
+            edges[arc.to] = arc.edge_id;
+            queue.push({candidate_weight, arc.to});
+          }
+        }
+      }
+
+      for (const auto& entry : hub_label) {
+        hub_weights[entry.hub_rank] = std::nullopt;
+      }
+      for (const VertexId vertex : touched) {
+        distances[vertex] = std::nullopt;
+        edges[vertex] = NO_EDGE;
+      }
+      touched.clear();
+    };
+
+    for (uint32_t hub_rank = 0; hub_rank < vertex_count; ++hub_rank) {
+      const VertexId hub = hubs[hub_rank];
+      search(hub_rank, graph_, out_labels[hub], in_labels);
+      search(hub_rank, backward_graph, in_labels[hub], out_labels);
+    }
+
+    out_labels_ = MakeLabels(std::move(out_labels));
+    in_labels_ = MakeLabels(std::move(in_labels));
+  }
+
+  // Hubs are added in rank order, so every label is already sorted
+  template <typename Weight>
+  typename HubLabeling<Weight>::Labels
+  HubLabeling<Weight>::MakeLabels(std::vector<std::vector<LabelEntry>> labels) {
+    Labels result;
+    result.offsets.reserve(labels.size() + 1);
+    result.offsets.push_back(0);
+    for (auto& label : labels) {
+      result.entries.insert(result.entries.end(), label.begin(), label.end());
+      result.offsets.push_back(result.entries.size());
+      label = {};
+    }
+    return result;
+  }
+
+  template <typename Weight>
+  typename HubLabeling<Weight>::Labels
+  HubLabeling<Weight>::ReadLabels(const TCatalog::HubLabelSet& set,
+                                  size_t vertex_count) {
+    if (static_cast<size_t>(set.offsets_size()) != vertex_count + 1 ||
+        set.hub_ranks_size() != set.weights_size() ||
+        set.edges_size() != set.weights_size() ||
+        set.offsets(vertex_count) != static_cast<uint32_t>(set.weights_size())) {
+      throw std::runtime_error("Hub labels don't match the graph");
+    }
+    Labels labels;
+    labels.offsets.assign(set.offsets().begin(), set.offsets().end());
+    labels.entries.reserve(set.weights_size());
+    for (int idx = 0; idx < set.weights_size(); ++idx) {
+      labels.entries.push_back(
+          LabelEntry{set.hub_ranks(idx), static_cast<Weight>(set.weights(idx)),
+                     set.edges(idx) ? set.edges(idx) - 1 : NO_EDGE});
+    }
+    return labels;
+  }
+
+  template <typename Weight>
+  void HubLabeling<Weight>::WriteLabels(const Labels& labels,
+                                        TCatalog::HubLabelSet& set) {
+    for (const uint32_t offset : labels.offsets) {
+      set.add_offsets(offset);
+    }
+    set.mutable_hub_ranks()->Reserve(labels.entries.size());
+    set.mutable_weights()->Reserve(labels.entries.size());
+    set.mutable_edges()->Reserve(labels.entries.size());
+    for (const auto& entry : labels.entries) {
+      set.add_hub_ranks(entry.hub_rank);
+      set.add_weights(static_cast<double>(entry.weight));
+      set.add_edges(entry.edge != NO_EDGE ? entry.edge + 1 : 0);
+    }
+  }
+
+  template <typename Weight>
+  TCatalog::HubLabels HubLabeling<Weight>::Serialize() const {
+    TCatalog::HubLabels labels;
+    WriteLabels(out_labels_, *labels.mutable_out_labels());
+    WriteLabels(in_labels_, *labels.mutable_in_labels());
+    return labels;
+  }
+
+  template <typename Weight>
+  const typename HubLabeling<Weight>::LabelEntry&
+  HubLabeling<Weight>::Labels::FindEntry(VertexId vertex,
+                                         uint32_t hub_rank) const {
+    const auto label = GetLabel(vertex);
+    return *std::lower_bound(label.begin(), label.end(), hub_rank,
+                             [](const LabelEntry& entry, uint32_t rank) {
+                               return entry.hub_rank < rank;
+                             });
+  }
+
+  template <typename Weight>
+  std::optional<std::pair<uint32_t, Weight>>
+  HubLabeling<Weight>::FindHub(VertexId from, VertexId to) const {
+    const auto out_label = out_labels_.GetLabel(from);
+    const auto in_label = in_labels_.GetLabel(to);
+    std::optional<std::pair<uint32_t, Weight>> best;
+    auto out_it = out_label.begin();
+    auto in_it = in_label.begin();
+    while (out_it != out_label.end() && in_it != in_label.end()) {
+      if (out_it->hub_rank < in_it->hub_rank) {
+        ++out_it;
+      }
+      else if (in_it->hub_rank < out_it->hub_rank) {
+        ++in_it;
+      }
+      else {
+        const Weight weight = out_it->weight + in_it->weight;
+        if (!best || weight < best->second) {
+          best = {out_it->hub_rank, weight};
+        }
+        ++out_it;
+        ++in_it;
+      }
+    }
+    return best;
+  }
+
+  template <typename Weight>
+  std::optional<Weight>
+  HubLabeling<Weight>::FindRoute(VertexId from, VertexId to,
+                                 std::vector<EdgeId>& edges,
+                                 [[maybe_unused]] QueryState& state) const {
+    edges.clear();
+    const auto hub = FindHub(from, to);
+    if (!hub) {
+      return std::nullopt;
+    }
+    const uint32_t hub_rank = hub->first;
+
+    for (VertexId vertex = from;;) {
+      const uint32_t edge = out_labels_.FindEntry(vertex, hub_rank).edge;
+      if (edge == NO_EDGE) {
+        break;
+      }
+      edges.push_back(edge);
+      vertex = graph_.GetEdge(edge).to;
+    }
+    const size_t to_hub_count = edges.size();
+    for (VertexId vertex = to;;) {
+      const uint32_t edge = in_labels_.FindEntry(vertex, hub_rank).edge;
+      if (edge == NO_EDGE) {
+        break;
+      }
+      edges.push_back(edge);
+      vertex = graph_.GetEdge(edge).from;
+    }
+    std::reverse(edges.begin() + to_hub_count, edges.end());
+
+    return hub->second;
+  }
+
+  template <typename Weight>
+  std::vector<std::optional<Weight>>
+  HubLabeling<Weight>::BuildRouteWeights(
+      VertexId from, const std::vector<VertexId>& targets,
+      [[maybe_unused]] QueryState& state) const {
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+      const auto hub = FindHub(from, to);
+      weights.push_back(hub ? std::optional<Weight>(hub->second)
+                            : std::nullopt);
+    }
+    return weights;
+  }
+
+}  // namespace Graph
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <istream>
 #include <map>
 #include <string>
@@ -13,7 +14,8 @@ namespace Json {
                                    int,
                                    double,
                                    bool,
-                                   std::string> {
+                                   std::string,
+                                   std::nullptr_t> {
    public:
     using variant::variant;
 
@@ -36,6 +38,9 @@ namespace Json {
     const auto& AsString() const {
       return std::get<std::string>(*this);
     }
+    bool IsNull() const {
+      return std::holds_alternative<std::nullptr_t>(*this);
+    }
   };
 
   class Document {
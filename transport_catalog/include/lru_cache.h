@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Bounded map evicting the least recently used entry,
+// capacity 0 turns it off
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+ public:
+  explicit LruCache(size_t capacity = 0) : capacity_(capacity) {}
+
+  // nullptr on miss, the pointer lives until the next Insert
+  const Value* Find(const Key& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      ++misses_;
+      return nullptr;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->second;
+  }
+
+  void Insert(const Key& key, Value value) {
+    if (capacity_ == 0) {
+      return;
+    }
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      it->second->second = std::move(value);
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return;
+    }
+    entries_.emplace_front(key, std::move(value));
+    index_[key] = entries_.begin();
+    if (entries_.size() > capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+  size_t GetCapacity() const { return capacity_; }
+  size_t GetHits() const { return hits_; }
+  size_t GetMisses() const { return misses_; }
+
+ private:
+  using Entries = std::list<std::pair<Key, Value>>;
+
+  size_t capacity_;
+  Entries entries_;
+  std::unordered_map<Key, typename Entries::iterator, Hash> index_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Graph {
+
+  // Route table file of fixed layout: a header, then V * V weights and
+  // V * V prev edges exactly as Router keeps them in memory. The file is
+  // mapped read-only, so query processes on one host share its pages
+  // instead of each parsing a private copy. Every written table gets a
+  // new generation, the base keeps it to tell its own table from one of
+  // another base with the same counts.
+  class MappedRouteTable {
+   public:
+    // Throws unless the file was written with this generation
+    MappedRouteTable(const std::string& file_name, uint64_t generation);
+    ~MappedRouteTable();
+
+    MappedRouteTable(const MappedRouteTable&) = delete;
+    MappedRouteTable& operator=(const MappedRouteTable&) = delete;
+
+    size_t GetVertexCount() const { return vertex_count_; }
+    // Edges of the graph the table was computed for
+    size_t GetEdgeCount() const { return edge_count_; }
+    size_t GetWeightSize() const { return weight_size_; }
+    const void* GetWeights() const;
+    const uint32_t* GetPrevEdges() const;
+
+    // Random and never 0, which bases without a mapped table have
+    static uint64_t MakeGeneration();
+    // Goes to a temporary file renamed over file_name, processes that
+    // have the old table mapped keep reading it
+    static void Write(const std::string& file_name, uint64_t generation,
+                      size_t vertex_count, size_t edge_count,
+                      size_t weight_size, const void* weights,
+                      const uint32_t* prev_edges);
+
+   private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    size_t vertex_count_ = 0;
+    size_t edge_count_ = 0;
+    size_t weight_size_ = 0;
+  };
+
+}  // namespace Graph
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace Graph {
+
+  // Min-plus row update of the all-pairs table:
+  //   if weight_from + through_weights[i] < from_weights[i] then
+  //     from_weights[i] = weight_from + through_weights[i]
+  //     from_prev_edges[i] = through_prev_edges[i], or prev_edge_from
+  //                          when it is no_edge
+  // Unreachable cells must hold infinity so they never win the comparison,
+  // integer weights use their maximum and sums that overflow are skipped.
+  template <typename Weight>
+  void RelaxRowMinPlusScalar(Weight* from_weights,
+                             uint32_t* from_prev_edges,
+                             const Weight* through_weights,
+                             const uint32_t* through_prev_edges,
+                             size_t count,
+                             Weight weight_from,
+                             uint32_t prev_edge_from,
+                             uint32_t no_edge) {
+    for (size_t i = 0; i < count; ++i) {
+      const Weight candidate_weight = weight_from + through_weights[i];
+      if constexpr (std::is_integral_v<Weight>) {
+        if (candidate_weight < weight_from) {
+          continue;
+        }
+      }
+      if (candidate_weight < from_weights[i]) {
+        from_weights[i] = candidate_weight;
+        from_prev_edges[i] = through_prev_edges[i] != no_edge
+                               ? through_prev_edges[i]
+                               : prev_edge_from;
+      }
+    }
+  }
+
+  // Same update for double weights, picks AVX2 or SSE2 at runtime when
+  // the CPU has them and falls back to the scalar loop otherwise
+  void RelaxRowMinPlus(double* from_weights,
+                       uint32_t* from_prev_edges,
+                       const double* through_weights,
+                       const uint32_t* through_prev_edges,
+                       size_t count,
+                       double weight_from,
+                       uint32_t prev_edge_from,
+                       uint32_t no_edge);
+
+  // Same update for fixed-point weights, AVX2 or the scalar loop
+  void RelaxRowMinPlus(uint32_t* from_weights,
+                       uint32_t* from_prev_edges,
+                       const uint32_t* through_weights,
+                       const uint32_t* through_prev_edges,
+                       size_t count,
+                       uint32_t weight_from,
+                       uint32_t prev_edge_from,
+                       uint32_t no_edge);
+
+}  // namespace Graph
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interned names: dense ids in order of adding, all characters in one
+// buffer. Lookups hash the name once and never allocate or insert.
+class NameTable {
+ public:
+  using Id = uint32_t;
+  static constexpr Id NO_ID = std::numeric_limits<Id>::max();
+
+  // Id of the name, it's added when new
+  Id Add(std::string_view name);
+  std::optional<Id> Find(std::string_view name) const;
+
+  std::string_view GetName(Id id) const {
+    return std::string_view(storage_).substr(
+        offsets_[id], offsets_[id + 1] - offsets_[id]);
+  }
+  size_t GetSize() const { return offsets_.size() - 1; }
+
+ private:
+  // Slot of the name or the empty one where it would go
+  size_t FindSlot(std::string_view name, size_t hash) const;
+  void Rehash(size_t slot_count);
+
+  std::string storage_;
+  // Name i is storage_[offsets_[i], offsets_[i + 1])
+  std::vector<uint32_t> offsets_ = {0};
+  std::vector<size_t> hashes_;
+  // Open addressing with linear probing, NO_ID in empty slots,
+  // the size is a power of two
+  std::vector<Id> slots_;
+};
@@ -0,0 +1,649 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "a_star_router.h"
+#include "csr_graph.h"
+#include "router.h"
+#include "transport_catalog.pb.h"
+
+namespace Graph {
+
+  // Multi-level partition overlay. Vertices are split into cells by
+  // recursive bisection of their points, cells of every level are unions
+  // of cells of the level below. The partition doesn't depend on weights.
+  //
+  // Customization gives every cell a clique: route weights inside the cell
+  // from each entry (head of an arc from another cell) to each exit (tail
+  // of an arc to another cell), level by level over the cliques of the
+  // level below. A query is Dijkstra that walks graph arcs only in the
+  // leaf cells of its ends, elsewhere it crosses whole cells of the highest
+  // level holding neither end by their cliques. New edge weights need only
+  // Customize, the partition stays.
+  template <typename Weight>
+  class PartitionOverlay : public RouterBase<Weight> {
+   private:
+    using Graph = CsrGraph<Weight>;
+
+   public:
+    // Partitions the graph by vertex points and customizes it
+    PartitionOverlay(const Graph& graph,
+                     const std::vector<SpherePoint>& points);
+    // Vertices missing in the stored partition join cells of their
+    // neighbours. Stored cliques are used when use_cliques is set and
+    // they were made for the same graph, otherwise it's customized again.
+    PartitionOverlay(const Graph& graph,
+                     const TCatalog::PartitionOverlay& overlay,
+                     bool use_cliques);
+
+    QueryStatePtr MakeQueryState() const override;
+    std::optional<Weight> FindRoute(VertexId from, VertexId to,
+                                    std::vector<EdgeId>& edges,
+                                    QueryState& state) const override;
+    std::vector<std::optional<Weight>> BuildRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets,
+        QueryState& state) const override;
+
+    // Cliques of all levels for the current edge weights
+    void Customize();
+
+    TCatalog::PartitionOverlay Serialize() const;
+
+   private:
+    static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+    static constexpr Weight NO_WEIGHT = std::numeric_limits<Weight>::max();
+    // Leaf cells take up to MIN_CELL_SIZE vertices, cells of every next
+    // level LEVEL_FACTOR times more
+    static constexpr size_t MIN_CELL_SIZE = 128;
+    static constexpr size_t LEVEL_FACTOR = 8;
+    static constexpr size_t MAX_LEVEL_COUNT = 4;
+
+    struct Level {
+      std::vector<uint32_t> cells;
+      uint32_t cell_count = 0;
+      // Entries and exits of cell c are [offsets[c], offsets[c + 1]),
+      // ordered by vertex id
+      std::vector<uint32_t> entry_offsets;
+      std::vector<VertexId> entries;
+      std::vector<uint32_t> exit_offsets;
+      std::vector<VertexId> exits;
+      // Place of the vertex among entries of its cell, NO_INDEX for others
+      std::vector<uint32_t> entry_indices;
+      // Clique of cell c starts at clique_offsets[c], a row of exit weights
+      // per entry, NO_WEIGHT where the cell has no route
+      std::vector<size_t> clique_offsets;
+      std::vector<Weight> weights;
+    };
+
+    // Both directions of every arc in compressed sparse row layout
+    struct Neighbours {
+      std::vector<uint32_t> offsets;
+      std::vector<uint32_t> vertices;
+    };
+
+    // Arc a vertex was reached by: a graph edge or a clique of the level
+    struct Parent {
+      VertexId from;
+      uint32_t edge;
+      int level;
+    };
+
+    // Kept between searches, only touched vertices are reset
+    struct SearchState : QueryState {
+      explicit SearchState(size_t vertex_count)
+          : distances(vertex_count), parents(vertex_count) {}
+
+      std::vector<std::optional<Weight>> distances;
+      std::vector<Parent> parents;
+      std::vector<VertexId> touched;
+
+      void Reset();
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem,
+                                      std::vector<QueueItem>,
+                                      std::greater<QueueItem>>;
+
+    static Neighbours MakeNeighbours(const Graph& graph);
+    void Partition(const std::vector<SpherePoint>& points);
+    void SplitCells(std::vector<VertexId> vertices, size_t level,
+                    const std::vector<size_t>& cell_sizes,
+                    const std::vector<SpherePoint>& points);
+    static std::pair<std::vector<VertexId>, std::vector<VertexId>>
+    Bisect(std::vector<VertexId> vertices,
+           const std::vector<SpherePoint>& points);
+    void JoinNewVertices(size_t old_vertex_count);
+    void BuildBoundaries();
+
+    // Highest level where the vertex is in other cells than both ends,
+    // -1 in their leaf cells
+    int GetQueryLevel(VertexId vertex, VertexId from, VertexId to) const;
+    std::optional<Weight> SearchRoute(VertexId from, VertexId to,
+                                      SearchState& state) const;
+    // Dijkstra where a vertex at level l >= 0 moves by the clique of its
+    // cell of level l and by arcs leaving that cell, at level -1 by all of
+    // its arcs. Vertices for which is_inside is false aren't reached.
+    template <typename LevelOf, typename IsInside, typename IsDone>
+    void Search(VertexId from, SearchState& state, LevelOf level_of,
+                IsInside is_inside, IsDone is_done) const;
+    // Edges of the state's last route, cliques are searched again
+    // inside their cells down to graph edges
+    void AppendRoute(VertexId from, VertexId to, SearchState& state,
+                     std::vector<EdgeId>& edges) const;
+
+    const Graph& graph_;
+    // From leaf cells up
+    std::vector<Level> levels_;
+  };
+
+
+  template <typename Weight>
+  PartitionOverlay<Weight>::PartitionOverlay(
+      const Graph& graph, const std::vector<SpherePoint>& points)
+      : graph_(graph) {
+    Partition(points);
+    BuildBoundaries();
+    Customize();
+  }
+
+  template <typename Weight>
+  PartitionOverlay<Weight>::PartitionOverlay(
+      const Graph& graph, const TCatalog::PartitionOverlay& overlay,
+      bool use_cliques)
+      : graph_(graph),
+        levels_(overlay.levels_size()) {
+    const size_t vertex_count = graph.GetVertexCount();
+    if (levels_.empty() ||
+        static_cast<size_t>(overlay.levels(0).cells_size()) > vertex_count) {
+      throw std::runtime_error("Partition overlay doesn't match the graph");
+    }
+    const size_t stored_vertex_count = overlay.levels(0).cells_size();
+    for (size_t level_idx = 0; level_idx < levels_.size(); ++level_idx) {
+      const auto& cells = overlay.levels(level_idx).cells();
+      if (static_cast<size_t>(cells.size()) != stored_vertex_count) {
+        throw std::runtime_error("Partition overlay doesn't match the graph");
+      }
+      Level& level = levels_[level_idx];
+      level.cells.assign(cells.begin(), cells.end());
+      level.cell_count =
+        cells.empty() ? 0 : *std::max_element(cells.begin(), cells.end()) + 1;
+    }
+    if (stored_vertex_count < vertex_count) {
+      JoinNewVertices(stored_vertex_count);
+    }
+    BuildBoundaries();
+
+    bool is_customized = use_cliques &&
+                         stored_vertex_count == vertex_count &&
+                         overlay.edge_count() == graph.GetEdgeCount();
+    for (size_t level_idx = 0; level_idx < levels_.size(); ++level_idx) {
+      is_customized = is_customized &&
+        static_cast<size_t>(overlay.levels(level_idx).weights_size()) ==
+          levels_[level_idx].weights.size();
+    }
+    if (!is_customized) {
+      Customize();
+      return;
+    }
+    for (size_t level_idx = 0; level_idx < levels_.size(); ++level_idx) {
+      const auto& weights = overlay.levels(level_idx).weights();
+      std::transform(weights.begin(), weights.end(),
+                     levels_[level_idx].weights.begin(),
+                     [](double weight) { return static_cast<Weight>(weight); });
+    }
+  }
+
+  template <typename Weight>
+  typename PartitionOverlay<Weight>::Neighbours
+  PartitionOverlay<Weight>::MakeNeighbours(const Graph& graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    Neighbours neighbours;
+    neighbours.offsets.assign(vertex_count + 1, 0);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      for (const auto& arc : graph.GetOutgoingArcs(vertex)) {
+        ++neighbours.offsets[vertex + 1];
+        ++neighbours.offsets[arc.to + 1];
+      }
+    }
+    std::partial_sum(neighbours.offsets.begin(), neighbours.offsets.end(),
+                     neighbours.offsets.begin());
+    neighbours.vertices.resize(neighbours.offsets.back());
+    std::vector<uint32_t> next(neighbours.offsets.begin(),
+                               neighbours.offsets.end() - 1);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      for (const auto& arc : graph.GetOutgoingArcs(vertex)) {
+        neighbours.vertices[next[vertex]++] = arc.to;
+        neighbours.vertices[next[arc.to]++] = vertex;
+      }
+    }
+    return neighbours;
+  }
+
+  template <typename Weight>
+  void PartitionOverlay<Weight>::Partition(
+      const std::vector<SpherePoint>& points) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    // Levels with cells smaller than the graph, at least one
+    std::vector<size_t> cell_sizes = {MIN_CELL_SIZE};
+    while (cell_sizes.size() < MAX_LEVEL_COUNT &&
+           cell_sizes.back() * LEVEL_FACTOR < vertex_count) {
+      cell_sizes.push_back(cell_sizes.back() * LEVEL_FACTOR);
+    }
+    levels_.assign(cell_sizes.size(), Level{});
+    for (Level& level : levels_) {
+      level.cells.assign(vertex_count, NO_INDEX);
+    }
+
+    std::vector<VertexId> vertices(vertex_count);
+    std::iota(vertices.begin(), vertices.end(), 0);
+    SplitCells(std::move(vertices), levels_.size() - 1, cell_sizes, points);
+  }
+
+  // Halved until they fit a cell of the level, then the cell is split
+  // further for the level below
+  template <typename Weight>
+  void PartitionOverlay<Weight>::SplitCells(
+      std::vector<VertexId> vertices, size_t level_idx,
+      const std::vector<size_t>& cell_sizes,
+      const std::vector<SpherePoint>& points) {
+    if (vertices.size() <= cell_sizes[level_idx]) {
+      Level& level = levels_[level_idx];
+      const uint32_t cell = level.cell_count++;
+      for (const VertexId vertex : vertices) {
+        level.cells[vertex] = cell;
+      }
+      if (level_idx > 0) {
+        SplitCells(std::move(vertices), level_idx - 1, cell_sizes, points);
+      }
+      return;
+    }
+    auto [lhs, rhs] = Bisect(std::move(vertices), points);
+    SplitCells(std::move(lhs), level_idx, cell_sizes, points);
+    SplitCells(std::move(rhs), level_idx, cell_sizes, points);
+  }
+
+  // At the median of the coordinate the points spread most along, so
+  // cells stay compact and few arcs cross them
+  template <typename Weight>
+  std::pair<std::vector<VertexId>, std::vector<VertexId>>
+  PartitionOverlay<Weight>::Bisect(std::vector<VertexId> vertices,
+                                   const std::vector<SpherePoint>& points) {
+    constexpr double SpherePoint::*AXES[] = {
+      &SpherePoint::x, &SpherePoint::y, &SpherePoint::z};
+    double best_spread = -1;
+    double SpherePoint::*axis = AXES[0];
+    for (const auto candidate : AXES) {
+      const auto [min_it, max_it] = std::minmax_element(
+          vertices.begin(), vertices.end(),
+          [&points, candidate](VertexId lhs, VertexId rhs) {
+            return points[lhs].*candidate < points[rhs].*candidate;
+          });
+      const double spread = points[*max_it].*candidate -
+                            points[*min_it].*candidate;
+      if (spread > best_spread) {
+        best_spread = spread;
+        axis = candidate;
+      }
+    }
+
+    const auto middle = vertices.begin() + vertices.size() / 2;
+    std::nth_element(vertices.begin(), middle, vertices.end(),
+                     [&points, axis](VertexId lhs, VertexId rhs) {
+                       return std::tie(points[lhs].*axis, lhs) <
+                              std::tie(points[rhs].*axis, rhs);
+                     });
+    std::vector<VertexId> rhs(middle, vertices.end());
+    vertices.erase(middle, vertices.end());
+    return {std::move(vertices), std::move(rhs)};
+  }
+
+  // Every new vertex takes the cells of all levels from a neighbour, so
+  // the levels stay nested; isolated ones get cells of their own
+  template <typename Weight>
+  void PartitionOverlay<Weight>::JoinNewVertices(size_t old_vertex_count) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    for (Level& level : levels_) {
+      level.cells.resize(vertex_count, NO_INDEX);
+    }
+    const Neighbours neighbours = MakeNeighbours(graph_);
+    std::queue<VertexId> queue;
+    for (VertexId vertex = 0; vertex < old_vertex_count; ++vertex) {
+      queue.push(vertex);
+    }
+    while (!queue.empty()) {
+      const VertexId vertex = queue.front();
+      queue.pop();
+      for (uint32_t idx = neighbours.offsets[vertex];
+           idx < neighbours.offsets[vertex + 1]; ++idx) {
+        const VertexId neighbour = neighbours.vertices[idx];
+        if (levels_[0].cells[neighbour] != NO_INDEX) {
+          continue;
+        }
+        for (Level& level : levels_) {
+          level.cells[neighbour] = level.cells[vertex];
+        }
+        queue.push(neighbour);
+      }
+    }
+    for (VertexId vertex = old_vertex_count; vertex < vertex_count; ++vertex) {
+      if (levels_[0].cells[vertex] == NO_INDEX) {
+        for (Level& level : levels_) {
+          level.cells[vertex] = level.cell_count++;
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  void PartitionOverlay<Weight>::BuildBoundaries() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    for (Level& level : levels_) {
+      std::vector<bool> is_entry(vertex_count, false);
+      std::vector<bool> is_exit(vertex_count, false);
+      for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+          if (level.cells[vertex] != level.cells[arc.to]) {
+            is_exit[vertex] = true;
+            is_entry[arc.to] = true;
+          }
+        }
+      }
+
+      // Counting sort by cell, stable in vertex ids
+      level.entry_offsets.assign(level.cell_count + 1, 0);
+      level.exit_offsets.assign(level.cell_count + 1, 0);
+      for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        level.entry_offsets[level.cells[vertex] + 1] += is_entry[vertex];
+        level.exit_offsets[level.cells[vertex] + 1] += is_exit[vertex];
+      }
+      std::partial_sum(level.entry_offsets.begin(), level.entry_offsets.end(),
+                       level.entry_offsets.begin());
+      std::partial_sum(level.exit_offsets.begin(), level.exit_offsets.end(),
+                       level.exit_offsets.begin());
+      level.entries.resize(level.entry_offsets.back());
+      level.exits.resize(level.exit_offsets.back());
+      level.entry_indices.assign(vertex_count, NO_INDEX);
+      std::vector<uint32_t> next_entry(level.entry_offsets.begin(),
+                                       level.entry_offsets.end() - 1);
+      std::vector<uint32_t> next_exit(level.exit_offsets.begin(),
+                                      level.exit_offsets.end() - 1);
+      for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        const uint32_t cell = level.cells[vertex];
+        if (is_entry[vertex]) {
+          level.entry_indices[vertex] =
+            next_entry[cell] - level.entry_offsets[cell];
+          level.entries[next_entry[cell]++] = vertex;
+        }
+        if (is_exit[vertex]) {
+          level.exits[next_exit[cell]++] = vertex;
+        }
+      }
+
+      level.clique_offsets.assign(level.cell_count + 1, 0);
+      for (uint32_t cell = 0; cell < level.cell_count; ++cell) {
+        level.clique_offsets[cell + 1] = level.clique_offsets[cell] +
+          static_cast<size_t>(level.entry_offsets[cell + 1] -
+                              level.entry_offsets[cell]) *
+          (level.exit_offsets[cell + 1] - level.exit_offsets[cell]);
+      }
+      level.weights.assign(level.clique_offsets.back(), NO_WEIGHT);
+    }
+  }
+
+  // A search from every entry inside its cell over the level below
+  template <typename Weight>
+  void PartitionOverlay<Weight>::Customize() {
+    SearchState state(graph_.GetVertexCount());
+    for (size_t level_idx = 0; level_idx < levels_.size(); ++level_idx) {
+      Level& level = levels_[level_idx];
+      const int search_level = static_cast<int>(level_idx) - 1;
+      for (uint32_t cell = 0; cell < level.cell_count; ++cell) {
+        const uint32_t exit_begin = level.exit_offsets[cell];
+        const uint32_t exit_count = level.exit_offsets[cell + 1] - exit_begin;
+        for (uint32_t entry_idx = level.entry_offsets[cell];
+             entry_idx < level.entry_offsets[cell + 1]; ++entry_idx) {
+          Search(level.entries[entry_idx], state,
+                 [search_level](VertexId) { return search_level; },
+                 [&level, cell](VertexId vertex) {
+                   return level.cells[vertex] == cell;
+                 },
+                 [](VertexId) { return false; });
+          Weight* row = level.weights.data() + level.clique_offsets[cell] +
+            static_cast<size_t>(entry_idx - level.entry_offsets[cell]) *
+            exit_count;
+          for (uint32_t exit_idx = 0; exit_idx < exit_count; ++exit_idx) {
+            const auto& distance =
+              state.distances[level.exits[exit_begin + exit_idx]];
+            row[exit_idx] = distance ? *distance : NO_WEIGHT;
+          }
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  int PartitionOverlay<Weight>::GetQueryLevel(VertexId vertex, VertexId from,
+                                              VertexId to) const {
+    for (int level_idx = static_cast<int>(levels_.size()) - 1;
+         level_idx >= 0; --level_idx) {
+      const auto& cells = levels_[level_idx].cells;
+      if (cells[vertex] != cells[from] && cells[vertex] != cells[to]) {
+        return level_idx;
+      }
+    }
+    return -1;
+  }
+
+  template <typename Weight>
+  QueryStatePtr PartitionOverlay<Weight>::MakeQueryState() const {
+    return std::make_unique<SearchState>(graph_.GetVertexCount());
+  }
+
+  template <typename Weight>
+  void PartitionOverlay<Weight>::SearchState::Reset() {
+    for (const VertexId vertex : touched) {
+      distances[vertex] = std::nullopt;
+    }
+    touched.clear();
+  }
+
+  template <typename Weight>
+  template <typename LevelOf, typename IsInside, typename IsDone>
+  void PartitionOverlay<Weight>::Search(VertexId from, SearchState& state,
+                                        LevelOf level_of, IsInside is_inside,
+                                        IsDone is_done) const {
+    state.Reset();
+
+    Queue queue;
+    auto relax = [&state, &queue](VertexId vertex, Weight weight,
+                                  Parent parent) {
+      auto& distance = state.distances[vertex];
+      if (!distance || weight < *distance) {
+        if (!distance) {
+          state.touched.push_back(vertex);
+        }
+        distance = weight;
+        state.parents[vertex] = parent;
+        queue.push({weight, vertex});
+      }
+    };
+    state.distances[from] = Weight{0};
+    state.touched.push_back(from);
+    queue.push({Weight{0}, from});
+    while (!queue.empty()) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (weight > *state.distances[vertex]) {
+        continue;
+      }
+      if (is_done(vertex)) {
+        break;
+      }
+
+      const int level_idx = level_of(vertex);
+      if (level_idx < 0) {
+        for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+          if (is_inside(arc.to)) {
+            relax(arc.to, weight + arc.weight,
+                  Parent{vertex, arc.edge_id, -1});
+          }
+        }
+        continue;
+      }
+      const Level& level = levels_[level_idx];
+      const uint32_t cell = level.cells[vertex];
+      const uint32_t entry_idx = level.entry_indices[vertex];
+      // Exits of the cell are inside whatever holds the cell
+      if (entry_idx != NO_INDEX) {
+        const uint32_t exit_begin = level.exit_offsets[cell];
+        const uint32_t exit_count = level.exit_offsets[cell + 1] - exit_begin;
+        const Weight* row = level.weights.data() + level.clique_offsets[cell] +
+                            static_cast<size_t>(entry_idx) * exit_count;
+        for (uint32_t exit_idx = 0; exit_idx < exit_count; ++exit_idx) {
+          if (row[exit_idx] != NO_WEIGHT) {
+            relax(level.exits[exit_begin + exit_idx], weight + row[exit_idx],
+                  Parent{vertex, NO_INDEX, level_idx});
+          }
+        }
+      }
+      for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+        if (level.cells[arc.to] != cell && is_inside(arc.to)) {
+          relax(arc.to, weight + arc.weight, Parent{vertex, arc.edge_id, -1});
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  std::optional<Weight>
+  PartitionOverlay<Weight>::SearchRoute(VertexId from, VertexId to,
+                                        SearchState& state) const {
+    Search(from, state,
+           [this, from, to](VertexId vertex) {
+             return GetQueryLevel(vertex, from, to);
+           },
+           [](VertexId) { return true; },
+           [to](VertexId vertex) { return vertex == to; });
+    return state.distances[to];
+  }
+
+  template <typename Weight>
+  void PartitionOverlay<Weight>::AppendRoute(
+      VertexId from, VertexId to, SearchState& state,
+      std::vector<EdgeId>& edges) const {
+    // Taken out first, unpacking a clique runs another search
+    std::vector<std::pair<Parent, VertexId>> steps;
+    for (VertexId vertex = to; vertex != from;
+         vertex = state.parents[vertex].from) {
+      steps.emplace_back(state.parents[vertex], vertex);
+    }
+    for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+      const auto& [parent, exit] = *it;
+      if (parent.edge != NO_INDEX) {
+        edges.push_back(parent.edge);
+        continue;
+      }
+      const Level& level = levels_[parent.level];
+      const uint32_t cell = level.cells[parent.from];
+      const int search_level = parent.level - 1;
+      Search(parent.from, state,
+             [search_level](VertexId) { return search_level; },
+             [&level, cell](VertexId vertex) {
+               return level.cells[vertex] == cell;
+             },
+             [exit](VertexId vertex) { return vertex == exit; });
+      AppendRoute(parent.from, exit, state, edges);
+    }
+  }
+
+  template <typename Weight>
+  std::optional<Weight>
+  PartitionOverlay<Weight>::FindRoute(VertexId from, VertexId to,
+                                      std::vector<EdgeId>& edges,
+                                      QueryState& state) const {
+    auto& search = dynamic_cast<SearchState&>(state);
+    edges.clear();
+    const auto weight = SearchRoute(from, to, search);
+    if (weight) {
+      AppendRoute(from, to, search, edges);
+    }
+    return weight;
+  }
+
+  // One search for all targets, cliques aren't unpacked. Cells holding
+  // the origin or any target are walked by graph arcs, so no clique
+  // crosses a target.
+  template <typename Weight>
+  std::vector<std::optional<Weight>>
+  PartitionOverlay<Weight>::BuildRouteWeights(
+      VertexId from, const std::vector<VertexId>& targets,
+      QueryState& state) const {
+    if (targets.empty()) {
+      return {};
+    }
+    auto& search = dynamic_cast<SearchState&>(state);
+    std::vector<std::vector<bool>> end_cells(levels_.size());
+    for (size_t level_idx = 0; level_idx < levels_.size(); ++level_idx) {
+      const Level& level = levels_[level_idx];
+      auto& is_end_cell = end_cells[level_idx];
+      is_end_cell.assign(level.cell_count, false);
+      is_end_cell[level.cells[from]] = true;
+      for (const VertexId to : targets) {
+        is_end_cell[level.cells[to]] = true;
+      }
+    }
+
+    std::unordered_set<VertexId> unsettled(targets.begin(), targets.end());
+    Search(from, search,
+           [this, &end_cells](VertexId vertex) {
+             for (int level_idx = static_cast<int>(levels_.size()) - 1;
+                  level_idx >= 0; --level_idx) {
+               if (!end_cells[level_idx][levels_[level_idx].cells[vertex]]) {
+                 return level_idx;
+               }
+             }
+             return -1;
+           },
+           [](VertexId) { return true; },
+           [&unsettled](VertexId vertex) {
+             return unsettled.erase(vertex) && unsettled.empty();
+           });
+
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+      weights.push_back(search.distances[to]);
+    }
+    return weights;
+  }
+
+  template <typename Weight>
+  TCatalog::PartitionOverlay PartitionOverlay<Weight>::Serialize() const {
+    TCatalog::PartitionOverlay overlay;
+    overlay.set_edge_count(graph_.GetEdgeCount());
+    for (const Level& level : levels_) {
+      TCatalog::OverlayLevel& stored_level = *overlay.add_levels();
+      stored_level.mutable_cells()->Add(level.cells.begin(),
+                                        level.cells.end());
+      stored_level.mutable_weights()->Reserve(level.weights.size());
+      for (const Weight weight : level.weights) {
+        stored_level.add_weights(static_cast<double>(weight));
+      }
+    }
+    return overlay;
+  }
+
+}  // namespace Graph
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+
+namespace Graph {
+
+  // One direction of a bus: the stops it visits and cumulative meters
+  // from the first of them
+  struct TransitRoute {
+    std::string bus_name;
+    std::vector<VertexId> stops;
+    std::vector<int64_t> meters;
+  };
+
+  // Round-based router in the RAPTOR manner working on bus stop arrays,
+  // no graph is built. Round k finds the best arrivals with k rides: every
+  // route through a stop improved in round k - 1 is scanned once from that
+  // stop on, boarding wherever the previous round arrived cheapest. Every
+  // boarding costs the wait, so it's exact for frequency-based buses, and
+  // of equally fast routes the one with the fewest rides wins. Queries
+  // keep their rounds to themselves, so they may run in many threads.
+  class RaptorRouter {
+   public:
+    struct Ride {
+      size_t route;
+      VertexId stop_from;
+      VertexId stop_to;
+      size_t span_count;
+      double time;
+    };
+
+    RaptorRouter(size_t stop_count, std::vector<TransitRoute> routes,
+                 double wait_time, double velocity);
+
+    // Total time of the journey, std::nullopt when to is unreachable,
+    // rides are replaced with the journey rides in order
+    std::optional<double> FindJourney(VertexId from, VertexId to,
+                                      std::vector<Ride>& rides) const;
+    // Times from one stop to every target, rounds run until no stop improves
+    std::vector<std::optional<double>> FindJourneyTimes(
+        VertexId from, const std::vector<VertexId>& targets) const;
+
+    const std::string& GetBusName(size_t route) const {
+      return routes_[route].bus_name;
+    }
+
+   private:
+    // How a stop was reached in a round
+    struct Label {
+      uint32_t route;
+      uint32_t board_position;
+      uint32_t alight_position;
+    };
+    static constexpr uint32_t NO_ROUTE = UINT32_MAX;
+
+    struct RouteVisit {
+      uint32_t route;
+      uint32_t position;
+    };
+
+    // Best arrivals after each round and labels of the stops improved in it
+    struct Rounds {
+      std::vector<std::vector<double>> arrivals;
+      std::vector<std::vector<Label>> labels;
+    };
+
+    double RideTime(const TransitRoute& route, size_t position_from,
+                    size_t position_to) const;
+    // Target is used for pruning only, a stop count value disables it
+    Rounds RunRounds(VertexId from, VertexId target) const;
+
+    const size_t stop_count_;
+    const std::vector<TransitRoute> routes_;
+    const double wait_time_;
+    const double velocity_;
+    // Routes through every stop with the positions they visit it at
+    std::vector<std::vector<RouteVisit>> stop_routes_;
+  };
+
+}  // namespace Graph
@@ -10,6 +10,7 @@
 
 #include "bus.h"
 #include "json.h"
+#include "router.h"
 #include "stop.h"
 #include "svg.h"
 #include "yellow_pages_structures.h"
@@ -18,6 +19,8 @@ enum class RequestType {
   QueryCompanyRequest,
   QueryBusRequest,
   QueryMapRequest,
+  QueryMatrixRequest,
+  QueryReachableRequest,
   QueryRouteRequest,
   QueryRouteToCompanyRequest,
   QueryStopRequest,
@@ -138,6 +141,53 @@ class QueryMapRequest : public QueryRequest {
 
 using QueryMapRequestPtr = std::unique_ptr<QueryMapRequest>;
 
+// Route times only, for every pair of origin and destination stops
+class QueryMatrixRequest : public QueryRequest {
+ public:
+  QueryMatrixRequest() : QueryRequest(RequestType::QueryMatrixRequest) {}
+  void SetFrom(std::vector<std::string> from) {
+    from_ = std::move(from);
+  }
+  const std::vector<std::string>& GetFrom() const {
+    return from_;
+  }
+  void SetTo(std::vector<std::string> to) {
+    to_ = std::move(to);
+  }
+  const std::vector<std::string>& GetTo() const {
+    return to_;
+  }
+ private:
+  std::vector<std::string> from_;
+  std::vector<std::string> to_;
+};
+
+using QueryMatrixRequestPtr = std::unique_ptr<QueryMatrixRequest>;
+
+// Stops within a time budget from one stop
+class QueryReachableRequest : public QueryRequest {
+ public:
+  QueryReachableRequest()
+      : QueryRequest(RequestType::QueryReachableRequest) {}
+  void SetFrom(const std::string& from) {
+    from_ = from;
+  }
+  const std::string& GetFrom() const {
+    return from_;
+  }
+  void SetMaxTime(double max_time) {
+    max_time_ = max_time;
+  }
+  double GetMaxTime() const {
+    return max_time_;
+  }
+ private:
+  std::string from_;
+  double max_time_ = 0;
+};
+
+using QueryReachableRequestPtr = std::unique_ptr<QueryReachableRequest>;
+
 class QueryCompanyRequestBase : public QueryRequest {
  public:
   explicit QueryCompanyRequestBase(RequestType type) : QueryRequest(type) {}
@@ -373,6 +423,77 @@ class RoutingSettingsRequest : public UpdateRequest {
         static_cast<double>(request_m.at("pedestrian_velocity").AsInt());
     }
     pedestrian_velocity_ *= (1000 / 60.0);  // KpH to MpM
+    if (request_m.count("router")) {
+      const std::string& router = request_m.at("router").AsString();
+      if (router == "floyd_warshall") {
+        router_type_ = RouterType::FloydWarshall;
+      }
+      else if (router == "dijkstra") {
+        router_type_ = RouterType::Dijkstra;
+      }
+      else if (router == "contraction_hierarchy") {
+        router_type_ = RouterType::ContractionHierarchy;
+      }
+      else if (router == "bidirectional_a_star") {
+        router_type_ = RouterType::BidirectionalAStar;
+      }
+      else if (router == "raptor") {
+        router_type_ = RouterType::Raptor;
+      }
+      else if (router == "hub_labels") {
+        router_type_ = RouterType::HubLabels;
+      }
+      else if (router == "partition_overlay") {
+        router_type_ = RouterType::PartitionOverlay;
+      }
+      else {
+        throw std::runtime_error("Unknown router in routing settings");
+      }
+    }
+    if (request_m.count("route_table")) {
+      const std::string& route_table = request_m.at("route_table").AsString();
+      if (route_table == "rebuild") {
+        route_table_ = RouteTableStorage::Rebuild;
+      }
+      else if (route_table == "embedded") {
+        route_table_ = RouteTableStorage::Embedded;
+      }
+      else if (route_table == "mapped") {
+        route_table_ = RouteTableStorage::Mapped;
+      }
+      else {
+        throw std::runtime_error("Unknown route table storage");
+      }
+    }
+    if (request_m.count("threads")) {
+      const int threads = request_m.at("threads").AsInt();
+      if (threads < 1) {
+        throw std::runtime_error("Routing threads must be positive");
+      }
+      threads_ = threads;
+    }
+    if (request_m.count("graph_model")) {
+      const std::string& graph_model = request_m.at("graph_model").AsString();
+      if (graph_model == "pairwise") {
+        graph_model_ = GraphModel::Pairwise;
+      }
+      else if (graph_model == "linear") {
+        graph_model_ = GraphModel::Linear;
+      }
+      else {
+        throw std::runtime_error("Unknown graph model in routing settings");
+      }
+    }
+    if (request_m.count("route_cache_size")) {
+      const int route_cache_size = request_m.at("route_cache_size").AsInt();
+      if (route_cache_size < 0) {
+        throw std::runtime_error("Route cache size must not be negative");
+      }
+      route_cache_size_ = route_cache_size;
+    }
+    if (request_m.count("prune_parallel_edges")) {
+      prune_parallel_edges_ = request_m.at("prune_parallel_edges").AsBool();
+    }
   }
   void SetBusWaitTime(int bus_wait_time) {
     bus_wait_time_ = bus_wait_time;
@@ -392,12 +513,67 @@ class RoutingSettingsRequest : public UpdateRequest {
   double GetPedestrianVelocity() {
     return pedestrian_velocity_;
   }
+  void SetRouterType(RouterType router_type) {
+    router_type_ = router_type;
+  }
+  RouterType GetRouterType() {
+    return router_type_;
+  }
+  void SetRouteTableStorage(RouteTableStorage route_table) {
+    route_table_ = route_table;
+  }
+  RouteTableStorage GetRouteTableStorage() {
+    return route_table_;
+  }
+  void SetThreads(size_t threads) {
+    threads_ = threads;
+  }
+  size_t GetThreads() {
+    return threads_;
+  }
+  void SetGraphModel(GraphModel graph_model) {
+    graph_model_ = graph_model;
+  }
+  GraphModel GetGraphModel() {
+    return graph_model_;
+  }
+  void SetRouteCacheSize(size_t route_cache_size) {
+    route_cache_size_ = route_cache_size;
+  }
+  size_t GetRouteCacheSize() {
+    return route_cache_size_;
+  }
+  void SetPruneParallelEdges(bool prune_parallel_edges) {
+    prune_parallel_edges_ = prune_parallel_edges;
+  }
+  bool GetPruneParallelEdges() {
+    return prune_parallel_edges_;
+  }
+  RouterSettings GetRouterSettings() const {
+    RouterSettings settings;
+    settings.bus_wait_time = bus_wait_time_;
+    settings.bus_velocity = bus_velocity_;
+    settings.pedestrian_velocity = pedestrian_velocity_;
+    settings.router_type = router_type_;
+    settings.route_table = route_table_;
+    settings.threads = threads_;
+    settings.graph_model = graph_model_;
+    settings.route_cache_size = route_cache_size_;
+    settings.prune_parallel_edges = prune_parallel_edges_;
+    return settings;
+  }
   ~RoutingSettingsRequest() = default;
 
  private:
   int bus_wait_time_;
   double bus_velocity_;
   double pedestrian_velocity_;
+  RouterType router_type_ = RouterType::FloydWarshall;
+  RouteTableStorage route_table_ = RouteTableStorage::Rebuild;
+  size_t threads_ = 1;
+  GraphModel graph_model_ = GraphModel::Pairwise;
+  size_t route_cache_size_ = 0;
+  bool prune_parallel_edges_ = false;
 };
 
 using RoutingSettingsRequestPtr = std::unique_ptr<RoutingSettingsRequest>;
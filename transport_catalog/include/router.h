@@ -1,152 +1,489 @@
-#pragma once
-
-#include <algorithm>
-#include <cassert>
-#include <cstdint>
-#include <iterator>
-#include <optional>
-#include <unordered_map>
-#include <utility>
-#include <vector>
-
-#include "graph.h"
-#include "transport_catalog.pb.h"
-
-struct RouterSettings {
-  int bus_wait_time;
-  double bus_velocity;
-  double pedestrian_velocity;
-};
-
-namespace Graph {
-
-  template <typename Weight>
-  class Router {
-   private:
-    using Graph = DirectedWeightedGraph<Weight>;
-
-   public:
-    explicit Router(const Graph& graph);
-
-    using RouteId = uint64_t;
-
-    struct RouteInfo {
-      RouteId id;
-      Weight weight;
-      size_t edge_count;
-    };
-
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
-    EdgeId GetRouteEdge(RouteId route_id, size_t edge_idx) const;
-    void ReleaseRoute(RouteId route_id);
-
-   private:
-    const Graph& graph_;
-
-    struct RouteInternalData {
-      Weight weight;
-      std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
-
-    using ExpandedRoute = std::vector<EdgeId>;
-    mutable RouteId next_route_id_ = 0;
-    mutable std::unordered_map<RouteId, ExpandedRoute> expanded_routes_cache_;
-
-    void InitializeRoutesInternalData(const Graph& graph) {
-      const size_t vertex_count = graph.GetVertexCount();
-      for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-        routes_internal_data_[vertex][vertex] = \
-            RouteInternalData{0, std::nullopt};
-        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-          const auto& edge = graph.GetEdge(edge_id);
-          assert(edge.weight >= 0);
-          auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-          if (!route_internal_data ||
-              route_internal_data->weight > edge.weight) {
-            route_internal_data = RouteInternalData{edge.weight, edge_id};
-          }
-        }
-      }
-    }
-
-    void RelaxRoute(VertexId vertex_from,
-                    VertexId vertex_to,
-                    const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-      auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-      const Weight candidate_weight = route_from.weight + route_to.weight;
-      if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-        route_relaxing = {
-            candidate_weight,
-            route_to.prev_edge
-                ? route_to.prev_edge
-                : route_from.prev_edge
-        };
-      }
-    }
-
-    void RelaxRoutesInternalDataThroughVertex(size_t v_count,
-                                              VertexId v_through) {
-      for (VertexId v_from = 0; v_from < v_count; ++v_from) {
-        if (const auto& route_from = routes_internal_data_[v_from][v_through]) {
-          for (VertexId v_to = 0; v_to < v_count; ++v_to) {
-            if (const auto& route_to = routes_internal_data_[v_through][v_to]) {
-              RelaxRoute(v_from, v_to, *route_from, *route_to);
-            }
-          }
-        }
-      }
-    }
-
-    RoutesInternalData routes_internal_data_;
-  };
-
-
-  template <typename Weight>
-  Router<Weight>::Router(const Graph& graph)
-      : graph_(graph),
-        routes_internal_data_(graph.GetVertexCount(),
-        std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount())) {
-    InitializeRoutesInternalData(graph);
-
-    const size_t v_count = graph.GetVertexCount();
-    for (VertexId v_through = 0; v_through < v_count; ++v_through) {
-      RelaxRoutesInternalDataThroughVertex(v_count, v_through);
-    }
-  }
-
-
-  template <typename Weight>
-  std::optional<typename Router<Weight>::RouteInfo>
-  Router<Weight>::BuildRoute(VertexId from, VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_[from][to];
-    if (!route_internal_data) {
-      return std::nullopt;
-    }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge) {
-      edges.push_back(*edge_id);
-    }
-    std::reverse(std::begin(edges), std::end(edges));
-
-    const RouteId route_id = next_route_id_++;
-    const size_t route_edge_count = edges.size();
-    expanded_routes_cache_[route_id] = std::move(edges);
-    return RouteInfo{route_id, weight, route_edge_count};
-  }
-
-  template <typename Weight>
-  EdgeId Router<Weight>::GetRouteEdge(RouteId route_id, size_t edge_idx) const {
-    return expanded_routes_cache_.at(route_id)[edge_idx];
-  }
-
-  template <typename Weight>
-  void Router<Weight>::ReleaseRoute(RouteId route_id) {
-    expanded_routes_cache_.erase(route_id);
-  }
-
-}  // namespace Graph
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "barrier.h"
+#include "csr_graph.h"
+#include "mapped_route_table.h"
+#include "graph.h"
+#include "min_plus.h"
+#include "transport_catalog.pb.h"
+
+enum class RouterType {
+  FloydWarshall,
+  Dijkstra,
+  ContractionHierarchy,
+  BidirectionalAStar,
+  // Scans bus stop arrays round by round, builds no graph
+  Raptor,
+  HubLabels,
+  PartitionOverlay
+};
+
+// Where process_requests takes the Floyd-Warshall table from
+enum class RouteTableStorage {
+  Rebuild,
+  Embedded,
+  // Separate file next to the base, mapped by process_requests
+  Mapped
+};
+
+// How bus rides are turned into graph edges
+enum class GraphModel {
+  // Edge for every ordered pair of stops on a bus, quadratic in route length
+  Pairwise,
+  // Board, ride and alight edges through per-bus ride vertices, linear
+  Linear
+};
+
+struct RouterSettings {
+  int bus_wait_time;
+  double bus_velocity;
+  double pedestrian_velocity;
+  RouterType router_type = RouterType::FloydWarshall;
+  RouteTableStorage route_table = RouteTableStorage::Rebuild;
+  // Worker threads of the Floyd-Warshall precompute
+  size_t threads = 1;
+  GraphModel graph_model = GraphModel::Pairwise;
+  // Route answers kept by process_requests, 0 disables the cache
+  size_t route_cache_size = 0;
+  // Keep only the edge routers would pick of ones with the same ends
+  bool prune_parallel_edges = false;
+};
+
+namespace Graph {
+
+  // Scratch of the searches a router runs at query time. Queries given
+  // the same state reuse its arrays, so a state serves one thread, while
+  // the router itself never changes after construction and may serve
+  // many threads at once, a state per thread.
+  class QueryState {
+   public:
+    virtual ~QueryState() = default;
+  };
+
+  using QueryStatePtr = std::unique_ptr<QueryState>;
+
+  // Common interface of all routing engines. Queries write route edges
+  // into a caller's buffer and take a state made by MakeQueryState of
+  // the same router.
+  template <typename Weight>
+  class RouterBase {
+   public:
+    virtual ~RouterBase() = default;
+
+    // Routers without query time searches need no scratch
+    virtual QueryStatePtr MakeQueryState() const {
+      return std::make_unique<QueryState>();
+    }
+    // Weight of the route, std::nullopt when to is unreachable,
+    // edges are replaced with the route edges in path order
+    virtual std::optional<Weight> FindRoute(VertexId from, VertexId to,
+                                            std::vector<EdgeId>& edges,
+                                            QueryState& state) const = 0;
+    // Route weights from one vertex to every target, std::nullopt for
+    // unreachable ones. They equal what FindRoute gives for each pair,
+    // routers override it when the targets can share one search.
+    virtual std::vector<std::optional<Weight>> BuildRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets,
+        QueryState& state) const;
+    // Same for many sources, one row of weights per source. By default
+    // it's BuildRouteWeights for every source.
+    virtual std::vector<std::vector<std::optional<Weight>>>
+    BuildRouteWeightsTable(const std::vector<VertexId>& sources,
+                           const std::vector<VertexId>& targets,
+                           QueryState& state) const;
+  };
+
+
+  template <typename Weight>
+  std::vector<std::optional<Weight>>
+  RouterBase<Weight>::BuildRouteWeights(
+      VertexId from, const std::vector<VertexId>& targets,
+      QueryState& state) const {
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    std::vector<EdgeId> edges;
+    for (const VertexId to : targets) {
+      weights.push_back(FindRoute(from, to, edges, state));
+    }
+    return weights;
+  }
+
+  template <typename Weight>
+  std::vector<std::vector<std::optional<Weight>>>
+  RouterBase<Weight>::BuildRouteWeightsTable(
+      const std::vector<VertexId>& sources,
+      const std::vector<VertexId>& targets,
+      QueryState& state) const {
+    std::vector<std::vector<std::optional<Weight>>> table;
+    table.reserve(sources.size());
+    for (const VertexId from : sources) {
+      table.push_back(BuildRouteWeights(from, targets, state));
+    }
+    return table;
+  }
+
+
+  // All-pairs router: Floyd-Warshall over the whole graph in constructor.
+  // With several threads the rows of every phase are split between them,
+  // each cell still sees the same relaxations in the same order, so the
+  // result doesn't depend on the thread count. FindRoute only reads the
+  // table, so one router may serve queries from many threads at once.
+  template <typename Weight>
+  class Router : public RouterBase<Weight> {
+   private:
+    using Graph = CsrGraph<Weight>;
+
+   public:
+    explicit Router(const Graph& graph, size_t thread_count = 1);
+    // Takes a table computed earlier for the same graph instead of
+    // running Floyd-Warshall again
+    Router(const Graph& graph, const TCatalog::RouteTable& table);
+    // Table of a smaller graph: its vertices and edges are the first ones
+    // of this graph, the rest are inserted into the table one by one
+    Router(const Graph& graph, const TCatalog::RouteTable& table,
+           size_t table_vertex_count, size_t table_edge_count);
+    // Reads the table right from the mapping, nothing is copied
+    Router(const Graph& graph, std::shared_ptr<const MappedRouteTable> table);
+    // Mapped table of a smaller graph, copied and repaired as above
+    Router(const Graph& graph, const MappedRouteTable& table,
+           size_t table_vertex_count, size_t table_edge_count);
+
+    std::optional<Weight> FindRoute(VertexId from, VertexId to,
+                                    std::vector<EdgeId>& edges,
+                                    QueryState& state) const override;
+    std::vector<std::optional<Weight>> BuildRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets,
+        QueryState& state) const override;
+
+    TCatalog::RouteTable SerializeRoutesInternalData() const;
+    void WriteRoutesFile(const std::string& file_name,
+                         uint64_t generation) const;
+
+   private:
+    const Graph& graph_;
+
+    // Row-major V*V table kept as two parallel arrays so rows can be relaxed
+    // with vector instructions. Unreachable pairs hold UNREACHABLE weight,
+    // routes without edges hold NO_EDGE.
+    static constexpr Weight UNREACHABLE =
+        std::numeric_limits<Weight>::has_infinity
+            ? std::numeric_limits<Weight>::infinity()
+            : std::numeric_limits<Weight>::max();
+    static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+
+    size_t GetCellIndex(VertexId vertex_from, VertexId vertex_to) const {
+      return vertex_from * v_count_ + vertex_to;
+    }
+
+    // Queries read the table through these, it may be mapped
+    const Weight* GetWeights() const {
+      return mapped_table_
+        ? static_cast<const Weight*>(mapped_table_->GetWeights())
+        : weights_.data();
+    }
+    const uint32_t* GetPrevEdges() const {
+      return mapped_table_ ? mapped_table_->GetPrevEdges()
+                           : prev_edges_.data();
+    }
+
+    void CheckTableSize(size_t table_vertex_count,
+                        size_t table_edge_count) const {
+      if (table_vertex_count > v_count_ ||
+          table_edge_count > graph_.GetEdgeCount()) {
+        throw std::runtime_error("Route table doesn't match the graph");
+      }
+    }
+    // Vertices and edges beyond the table ones are added to it
+    void RepairTable(size_t table_vertex_count, size_t table_edge_count) {
+      for (VertexId vertex = table_vertex_count; vertex < v_count_; ++vertex) {
+        weights_[GetCellIndex(vertex, vertex)] = 0;
+      }
+      for (EdgeId edge_id = table_edge_count; edge_id < graph_.GetEdgeCount();
+           ++edge_id) {
+        InsertEdge(edge_id);
+      }
+    }
+
+    void InitializeRoutesInternalData(const Graph& graph) {
+      for (VertexId vertex = 0; vertex < v_count_; ++vertex) {
+        weights_[GetCellIndex(vertex, vertex)] = 0;
+        for (const auto& arc : graph.GetOutgoingArcs(vertex)) {
+          assert(arc.weight >= 0);
+          const size_t idx = GetCellIndex(vertex, arc.to);
+          if (weights_[idx] > arc.weight) {
+            weights_[idx] = arc.weight;
+            prev_edges_[idx] = arc.edge_id;
+          }
+        }
+      }
+    }
+
+    // Rows [v_from_begin, v_from_end) only, the row of v_through can't
+    // change in its own phase and is skipped so other threads may read it
+    void RelaxRoutesInternalDataThroughVertex(VertexId v_through,
+                                              VertexId v_from_begin,
+                                              VertexId v_from_end) {
+      const Weight* through_weights = weights_.data() + GetCellIndex(v_through, 0);
+      const uint32_t* through_prev_edges = prev_edges_.data() + GetCellIndex(v_through, 0);
+      for (VertexId v_from = v_from_begin; v_from < v_from_end; ++v_from) {
+        if (v_from == v_through) {
+          continue;
+        }
+        const Weight weight_from = weights_[GetCellIndex(v_from, v_through)];
+        if (weight_from == UNREACHABLE) {
+          continue;
+        }
+        const uint32_t prev_edge_from = prev_edges_[GetCellIndex(v_from, v_through)];
+        Weight* from_weights = weights_.data() + GetCellIndex(v_from, 0);
+        uint32_t* from_prev_edges = prev_edges_.data() + GetCellIndex(v_from, 0);
+        if constexpr (std::is_same_v<Weight, double> ||
+                      std::is_same_v<Weight, uint32_t>) {
+          RelaxRowMinPlus(from_weights, from_prev_edges,
+                          through_weights, through_prev_edges, v_count_,
+                          weight_from, prev_edge_from, NO_EDGE);
+        } else {
+          RelaxRowMinPlusScalar(from_weights, from_prev_edges,
+                                through_weights, through_prev_edges, v_count_,
+                                weight_from, prev_edge_from, NO_EDGE);
+        }
+      }
+    }
+
+    // Incremental repair after an edge got added or cheaper: a route can
+    // only improve by going through it, so every pair is checked against
+    // from -> edge -> to in O(V^2) instead of a full Floyd-Warshall. The
+    // routes to edge.from and from edge.to can't change meanwhile.
+    void InsertEdge(EdgeId edge_id) {
+      const Edge<Weight> edge = graph_.GetEdge(edge_id);
+      assert(edge.weight >= 0);
+      std::vector<VertexId> heads;
+      std::vector<VertexId> tails;
+      for (VertexId vertex = 0; vertex < v_count_; ++vertex) {
+        if (weights_[GetCellIndex(vertex, edge.from)] != UNREACHABLE) {
+          heads.push_back(vertex);
+        }
+        if (weights_[GetCellIndex(edge.to, vertex)] != UNREACHABLE) {
+          tails.push_back(vertex);
+        }
+      }
+      for (const VertexId v_from : heads) {
+        const Weight weight_from =
+            weights_[GetCellIndex(v_from, edge.from)] + edge.weight;
+        for (const VertexId v_to : tails) {
+          const size_t idx = GetCellIndex(v_from, v_to);
+          const size_t tail_idx = GetCellIndex(edge.to, v_to);
+          const Weight candidate = weight_from + weights_[tail_idx];
+          if (candidate < weights_[idx]) {
+            weights_[idx] = candidate;
+            prev_edges_[idx] = prev_edges_[tail_idx] != NO_EDGE
+                                 ? prev_edges_[tail_idx]
+                                 : static_cast<uint32_t>(edge_id);
+          }
+        }
+      }
+    }
+
+    void RelaxRoutesInternalData(size_t thread_count) {
+      if (thread_count <= 1) {
+        for (VertexId v_through = 0; v_through < v_count_; ++v_through) {
+          RelaxRoutesInternalDataThroughVertex(v_through, 0, v_count_);
+        }
+        return;
+      }
+      Barrier barrier(thread_count);
+      std::vector<std::thread> workers;
+      workers.reserve(thread_count);
+      for (size_t t = 0; t < thread_count; ++t) {
+        const VertexId v_from_begin = v_count_ * t / thread_count;
+        const VertexId v_from_end = v_count_ * (t + 1) / thread_count;
+        workers.emplace_back([&, v_from_begin, v_from_end] {
+          for (VertexId v_through = 0; v_through < v_count_; ++v_through) {
+            RelaxRoutesInternalDataThroughVertex(v_through,
+                                                 v_from_begin, v_from_end);
+            barrier.Wait();
+          }
+        });
+      }
+      for (auto& worker : workers) {
+        worker.join();
+      }
+    }
+
+    const size_t v_count_;
+    // Empty when the table is mapped
+    std::vector<Weight> weights_;
+    std::vector<uint32_t> prev_edges_;
+    std::shared_ptr<const MappedRouteTable> mapped_table_;
+  };
+
+
+  template <typename Weight>
+  Router<Weight>::Router(const Graph& graph, size_t thread_count)
+      : graph_(graph),
+        v_count_(graph.GetVertexCount()),
+        weights_(v_count_ * v_count_, UNREACHABLE),
+        prev_edges_(v_count_ * v_count_, NO_EDGE) {
+    InitializeRoutesInternalData(graph);
+    RelaxRoutesInternalData(std::min(thread_count,
+                                     std::max<size_t>(v_count_, 1)));
+  }
+
+  template <typename Weight>
+  Router<Weight>::Router(const Graph& graph, const TCatalog::RouteTable& table)
+      : Router(graph, table, graph.GetVertexCount(), graph.GetEdgeCount()) {}
+
+  template <typename Weight>
+  Router<Weight>::Router(const Graph& graph, const TCatalog::RouteTable& table,
+                         size_t table_vertex_count, size_t table_edge_count)
+      : graph_(graph),
+        v_count_(graph.GetVertexCount()),
+        weights_(v_count_ * v_count_, UNREACHABLE),
+        prev_edges_(v_count_ * v_count_, NO_EDGE) {
+    CheckTableSize(table_vertex_count, table_edge_count);
+    if (static_cast<size_t>(table.weights_size()) !=
+          table_vertex_count * table_vertex_count ||
+        table.prev_edges_size() != table.weights_size()) {
+      throw std::runtime_error("Route table doesn't match the graph");
+    }
+    for (size_t table_idx = 0; table_idx < static_cast<size_t>(table.weights_size());
+         ++table_idx) {
+      const double weight = table.weights(table_idx);
+      if (std::isinf(weight)) {
+        continue;
+      }
+      const uint32_t prev_edge = table.prev_edges(table_idx);
+      const size_t idx = GetCellIndex(table_idx / table_vertex_count,
+                                      table_idx % table_vertex_count);
+      weights_[idx] = static_cast<Weight>(weight);
+      prev_edges_[idx] = prev_edge ? prev_edge - 1 : NO_EDGE;
+    }
+    RepairTable(table_vertex_count, table_edge_count);
+  }
+
+  template <typename Weight>
+  Router<Weight>::Router(const Graph& graph,
+                         std::shared_ptr<const MappedRouteTable> table)
+      : graph_(graph),
+        v_count_(graph.GetVertexCount()),
+        mapped_table_(std::move(table)) {
+    if (mapped_table_->GetVertexCount() != v_count_ ||
+        mapped_table_->GetEdgeCount() != graph.GetEdgeCount() ||
+        mapped_table_->GetWeightSize() != sizeof(Weight)) {
+      throw std::runtime_error("Route table doesn't match the graph");
+    }
+  }
+
+  template <typename Weight>
+  Router<Weight>::Router(const Graph& graph, const MappedRouteTable& table,
+                         size_t table_vertex_count, size_t table_edge_count)
+      : graph_(graph),
+        v_count_(graph.GetVertexCount()),
+        weights_(v_count_ * v_count_, UNREACHABLE),
+        prev_edges_(v_count_ * v_count_, NO_EDGE) {
+    CheckTableSize(table_vertex_count, table_edge_count);
+    if (table.GetVertexCount() != table_vertex_count ||
+        table.GetEdgeCount() != table_edge_count ||
+        table.GetWeightSize() != sizeof(Weight)) {
+      throw std::runtime_error("Route table doesn't match the graph");
+    }
+    const Weight* table_weights =
+      static_cast<const Weight*>(table.GetWeights());
+    const uint32_t* table_prev_edges = table.GetPrevEdges();
+    for (VertexId vertex = 0; vertex < table_vertex_count; ++vertex) {
+      const size_t table_idx = vertex * table_vertex_count;
+      std::copy_n(table_weights + table_idx, table_vertex_count,
+                  weights_.begin() + GetCellIndex(vertex, 0));
+      std::copy_n(table_prev_edges + table_idx, table_vertex_count,
+                  prev_edges_.begin() + GetCellIndex(vertex, 0));
+    }
+    RepairTable(table_vertex_count, table_edge_count);
+  }
+
+  template <typename Weight>
+  TCatalog::RouteTable Router<Weight>::SerializeRoutesInternalData() const {
+    const Weight* weights = GetWeights();
+    const uint32_t* prev_edges = GetPrevEdges();
+    const size_t cell_count = v_count_ * v_count_;
+    TCatalog::RouteTable table;
+    table.mutable_weights()->Reserve(cell_count);
+    table.mutable_prev_edges()->Reserve(cell_count);
+    for (size_t idx = 0; idx < cell_count; ++idx) {
+      if (weights[idx] == UNREACHABLE) {
+        table.add_weights(std::numeric_limits<double>::infinity());
+        table.add_prev_edges(0);
+        continue;
+      }
+      table.add_weights(static_cast<double>(weights[idx]));
+      table.add_prev_edges(prev_edges[idx] != NO_EDGE
+                             ? prev_edges[idx] + 1
+                             : 0);
+    }
+    return table;
+  }
+
+  template <typename Weight>
+  void Router<Weight>::WriteRoutesFile(const std::string& file_name,
+                                       uint64_t generation) const {
+    MappedRouteTable::Write(file_name, generation, v_count_,
+                            graph_.GetEdgeCount(), sizeof(Weight),
+                            GetWeights(), GetPrevEdges());
+  }
+
+
+  template <typename Weight>
+  std::optional<Weight>
+  Router<Weight>::FindRoute(VertexId from, VertexId to,
+                            std::vector<EdgeId>& edges,
+                            [[maybe_unused]] QueryState& state) const {
+    edges.clear();
+    const Weight weight = GetWeights()[GetCellIndex(from, to)];
+    if (weight == UNREACHABLE) {
+      return std::nullopt;
+    }
+    const uint32_t* prev_edges = GetPrevEdges();
+    for (uint32_t edge_id = prev_edges[GetCellIndex(from, to)];
+         edge_id != NO_EDGE;
+         edge_id = prev_edges[GetCellIndex(from, graph_.GetEdge(edge_id).from)]) {
+      edges.push_back(edge_id);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+
+    return weight;
+  }
+
+  template <typename Weight>
+  std::vector<std::optional<Weight>>
+  Router<Weight>::BuildRouteWeights(VertexId from,
+                                    const std::vector<VertexId>& targets,
+                                    [[maybe_unused]] QueryState& state) const {
+    const Weight* table_weights = GetWeights();
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(targets.size());
+    for (const VertexId to : targets) {
+      const Weight weight = table_weights[GetCellIndex(from, to)];
+      if (weight == UNREACHABLE) {
+        weights.push_back(std::nullopt);
+      }
+      else {
+        weights.push_back(weight);
+      }
+    }
+    return weights;
+  }
+
+}  // namespace Graph
@@ -1,51 +1,130 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <map>
 #include <memory>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "a_star_router.h"
 #include "bus.h"
+#include "contraction_hierarchy.h"
+#include "csr_graph.h"
+#include "dijkstra_router.h"
 #include "graph.h"
+#include "name_table.h"
+#include "hub_labeling.h"
+#include "partition_overlay.h"
+#include "raptor_router.h"
 #include "router.h"
 #include "stop.h"
 #include "transport_catalog.pb.h"
 #include "yellow_pages_structures.h"
 
-using RouterPtr = std::unique_ptr<Graph::Router<double>>;
-using GraphPtr = std::unique_ptr<Graph::DirectedWeightedGraph<double>>;
+// Edge and route weights: double minutes, or with FIXED_POINT_WEIGHTS
+// integer ticks of TransportRouter::ticks_per_minute_
+#ifdef FIXED_POINT_WEIGHTS
+using RouteWeight = uint32_t;
+#else
+using RouteWeight = double;
+#endif
+
+using RouterPtr = std::unique_ptr<Graph::RouterBase<RouteWeight>>;
+using GraphPtr = std::unique_ptr<Graph::CsrGraph<RouteWeight>>;
+using RaptorRouterPtr = std::unique_ptr<Graph::RaptorRouter>;
 
 class TransportRouter {
  public:
-  // This one is for deserialization only!
-  TransportRouter(const TCatalog::Graph &g, const TCatalog::RouterSettings &r) {
-    bus_wait_time_ = r.bus_wait_time();
-    bus_velocity_ = r.bus_velocity();
-    pedestrian_velocity_ = r.pedestrian_velocity();
-
-    size_t vertex_count = g.vertices_size();
-    graph_ =
-      std::make_unique<Graph::DirectedWeightedGraph<double>>(vertex_count);
+  // This one is for deserialization only! With metric given, its wait
+  // time and velocities replace ones of the base: edge weights are made
+  // again from stored meters and routing preprocessing is redone for them
+  TransportRouter(const TCatalog::Graph &g, const TCatalog::RouterSettings &r,
+                  const std::map<std::string, Bus>& buses,
+                  const std::map<std::string, Stop>& stops,
+                  const std::string& base_file,
+                  const std::optional<RouterSettings>& metric = std::nullopt) {
+    ReadSettings(r);
+    size_t vertex_count = 0;
+    std::vector<Graph::Edge<RouteWeight>> edges = ReadGraph(g, vertex_count);
+    if (metric) {
+      SetMetric(*metric, edges);
+    }
+    graph_ = std::make_unique<Graph::CsrGraph<RouteWeight>>(vertex_count,
+                                                            edges);
 
-    id_to_stop.reserve(vertex_count);
-    edge_to_info.reserve(g.edges_info_size());
-    for (auto i = 0; i < g.vertices_size(); i++) {
-      id_to_stop.emplace_back(g.vertices(i));
-      stop_to_id[g.vertices(i)] = i;
+    if (router_type_ == RouterType::BidirectionalAStar ||
+        router_type_ == RouterType::PartitionOverlay) {
+      vertex_points_ = MakeVertexPoints(stops);
     }
 
-    for (auto i = 0; i < g.edges_size(); i++) {
-      const auto& e = g.edges(i);
-      graph_->AddEdge(Graph::Edge<double>{e.id_from(), e.id_to(), e.w()});
+    if (router_type_ == RouterType::Raptor) {
+      raptor_ = MakeRaptorRouter(buses, stops);
     }
+    else if (metric) {
+      router_ = CustomizeRouter(g);
+    }
+    else {
+      router_ = LoadRouter(g, base_file);
+    }
+  }
 
-    for (auto i = 0; i < g.edges_info_size(); i++) {
-      edge_to_info.emplace_back(g.edges_info(i).name(), g.edges_info(i).span());
+  // This one is for update_base: new stops and buses are appended to the
+  // stored graph, and a stored route table is repaired, not recomputed
+  TransportRouter(const TCatalog::Graph &g, const TCatalog::RouterSettings &r,
+                  const std::map<std::string, Bus>& new_buses,
+                  const std::map<std::string, Stop>& stops,
+                  const std::vector<std::string>& new_stops,
+                  const std::string& base_file) {
+    ReadSettings(r);
+    size_t vertex_count = 0;
+    std::vector<Graph::Edge<RouteWeight>> edges = ReadGraph(g, vertex_count);
+    const size_t old_vertex_count = vertex_count;
+    const size_t old_edge_count = edges.size();
+
+    vertex_stops_.resize(vertex_count, NameTable::NO_ID);
+    for (const auto& stop_name : new_stops) {
+      AddStopVertex(stop_name, vertex_count++);
+    }
+    AddBusEdges(new_buses, stops, edges, vertex_count);
+    if (prune_parallel_edges_) {
+      PruneParallelEdges(edges, old_edge_count);
     }
+    graph_ = std::make_unique<Graph::CsrGraph<RouteWeight>>(vertex_count,
+                                                            edges);
 
-    router_ = std::make_unique<Graph::Router<double>>(*graph_);
+    if (router_type_ == RouterType::PartitionOverlay &&
+        g.has_partition_overlay()) {
+      // New vertices join stored cells, only the cliques are recomputed
+      updated_overlay_ =
+        std::make_unique<Graph::PartitionOverlay<RouteWeight>>(
+            *graph_, g.partition_overlay(), true);
+    }
+    if (router_type_ != RouterType::FloydWarshall) {
+      return;
+    }
+    if (g.has_route_table()) {
+      repaired_table_ = std::make_unique<Graph::Router<RouteWeight>>(
+          *graph_, g.route_table(), old_vertex_count, old_edge_count);
+    }
+    else if (route_table_ == RouteTableStorage::Mapped) {
+      // Copied before SerializeGraph replaces the file
+      repaired_table_ = std::make_unique<Graph::Router<RouteWeight>>(
+          *graph_,
+          Graph::MappedRouteTable(GetRouteTableFile(base_file),
+                                  g.route_table_generation()),
+          old_vertex_count, old_edge_count);
+    }
   }
 
   TransportRouter(const std::map<std::string, Bus> buses,
@@ -53,64 +132,34 @@ class TransportRouter {
                   const RouterSettings& router_settings)
       : bus_wait_time_(static_cast<double>(router_settings.bus_wait_time)),
         bus_velocity_(router_settings.bus_velocity),
-        pedestrian_velocity_(router_settings.pedestrian_velocity) {
-    using namespace Graph;
-    int vertex_count = stops.size();
-
-    size_t unique_v_id = 0;
-    stop_to_id.reserve(vertex_count);
-    id_to_stop.reserve(vertex_count);
-
-    graph_ = std::make_unique<DirectedWeightedGraph<double>>(vertex_count);
-
+        pedestrian_velocity_(router_settings.pedestrian_velocity),
+        router_type_(router_settings.router_type),
+        route_table_(router_settings.route_table),
+        threads_(router_settings.threads),
+        graph_model_(router_settings.graph_model),
+        prune_parallel_edges_(router_settings.prune_parallel_edges) {
+    SetWeightUnits();
+    size_t vertex_count = 0;
+    vertex_stops_.reserve(stops.size());
+    stop_vertices_.reserve(stops.size());
     for (const auto& [k, v] : stops) {
-      stop_to_id.insert({k, unique_v_id++});
-      id_to_stop.push_back(k);
+      AddStopVertex(k, vertex_count++);
     }
 
-    for (const auto& [k, bus] : buses) {
-      const auto& bus_stops = bus.GetStops();
-      size_t bus_stops_size = bus_stops.size();
-      RouteType type = bus.GetType();
-      if (type == RouteType::ROUND) {
-        for (size_t i = 0; i < bus_stops_size - 1; i++) {
-          for (size_t j = i + 1; j < bus_stops_size; j++) {
-            double t = TimeBetweenStops(bus_stops, stops, i, j);
-            size_t idx_i = stop_to_id[bus_stops[i]];
-            size_t idx_j = stop_to_id[bus_stops[j]];
-            graph_->AddEdge(Edge<double>{idx_i, idx_j, t + bus_wait_time_});
-            edge_to_info.push_back({bus.GetName(), j - i});
-          }
-        }
-      }
-      else if (type == RouteType::TWOWAY) {
-        // -->
-        for (size_t i = 0; i < bus_stops_size - 1; i++) {
-          for (size_t j = i + 1; j < bus_stops_size; j++) {
-            double t = TimeBetweenStops(bus_stops, stops, i, j);
-            size_t idx_i = stop_to_id[bus_stops[i]];
-            size_t idx_j = stop_to_id[bus_stops[j]];
-            graph_->AddEdge(Edge<double>{idx_i, idx_j, t + bus_wait_time_});
-            edge_to_info.push_back({bus.GetName(), j - i});
-          }
-        }
-        // <--
-        for (size_t i = 0; i < bus_stops_size - 1; i++) {
-          for (size_t j = i + 1; j < bus_stops_size; j++) {
-            double t = TimeBetweenStops(bus_stops, stops, j, i);
-            size_t idx_j = stop_to_id[bus_stops[j]];
-            size_t idx_i = stop_to_id[bus_stops[i]];
-            graph_->AddEdge(Edge<double>{idx_j, idx_i, t + bus_wait_time_});
-            edge_to_info.push_back({bus.GetName(), j - i});
-          }
-        }
-      }
-      else {
-        throw std::runtime_error("Unknown bus type");
-      }
+    // Build the graph in the chosen model and freeze it for routing
+    std::vector<Graph::Edge<RouteWeight>> edges;
+    AddBusEdges(buses, stops, edges, vertex_count);
+    if (prune_parallel_edges_) {
+      PruneParallelEdges(edges, 0);
+    }
+    graph_ = std::make_unique<Graph::CsrGraph<RouteWeight>>(vertex_count,
+                                                            edges);
+    // The partition follows stop coordinates
+    if (router_type_ == RouterType::PartitionOverlay) {
+      vertex_points_ = MakeVertexPoints(stops);
     }
     // This is not needed due to parting the program in make/execute parts
-    // router_ = std::make_unique<Graph::Router<double>>(*graph_);
+    // router_ = MakeRouter();
   }
 
   struct BusItem {
@@ -143,31 +192,183 @@ class TransportRouter {
 
   std::optional<RouteInfo> BuildRoute(const std::string& from,
                                       const std::string& to) {
-    size_t from_v = stop_to_id[from];
-    size_t to_v = stop_to_id[to];
+    return BuildRoute(GetStopVertex(from), GetStopVertex(to));
+  }
+
+  // Same for stops already resolved by GetStopId
+  std::optional<RouteInfo> BuildRoute(size_t from_v, size_t to_v) {
+    if (raptor_) {
+      return BuildRaptorRoute(from_v, to_v);
+    }
 
-    const auto route = router_->BuildRoute(from_v, to_v);
-    if (route == std::nullopt) {
+    std::vector<Graph::EdgeId> edges;
+    const auto weight = router_->FindRoute(from_v, to_v, edges,
+                                           GetQueryState());
+    if (weight == std::nullopt) {
       return std::nullopt;
     }
     RouteInfo route_info;
-    route_info.total_time = route->weight;
-    route_info.items.reserve(route->edge_count);
-    for (size_t i = 0; i < route->edge_count; i++) {
-      size_t edge_id = router_->GetRouteEdge(route->id, i);
-      const Graph::Edge<double>& e = graph_->GetEdge(edge_id);
-      const std::string& e_from = id_to_stop[e.from];
-      const std::string& e_to = id_to_stop[e.to];
-      route_info.items.push_back(
-        StopItem{e_from, static_cast<double>(bus_wait_time_)});
-      route_info.items.push_back(
-        BusItem{edge_to_info[edge_id].first, e_from, e_to,
-                edge_to_info[edge_id].second, e.weight - bus_wait_time_});
+    route_info.total_time = ToMinutes(*weight);
+    route_info.items.reserve(edges.size());
+    // Current ride of the linear model: boarding stop, weight and span so far
+    size_t ride_from = 0;
+    RouteWeight ride_weight = 0;
+    int ride_span = 0;
+    for (const size_t edge_id : edges) {
+      const Graph::Edge<RouteWeight> e = graph_->GetEdge(edge_id);
+      if (IsStopVertex(e.from) && IsStopVertex(e.to)) {
+        const std::string e_from(GetVertexStopName(e.from));
+        const std::string e_to(GetVertexStopName(e.to));
+        route_info.items.push_back(
+          StopItem{e_from, static_cast<double>(bus_wait_time_)});
+        route_info.items.push_back(
+          BusItem{GetEdgeBusName(edge_id), e_from, e_to,
+                  static_cast<int>(edge_infos_[edge_id].span),
+                  ToMinutes(e.weight - wait_weight_)});
+      }
+      else if (IsStopVertex(e.from)) {
+        ride_from = e.from;
+        ride_weight = 0;
+        ride_span = 0;
+      }
+      else if (!IsStopVertex(e.to)) {
+        ride_weight += e.weight;
+        ride_span += edge_infos_[edge_id].span;
+      }
+      else {
+        const std::string e_from(GetVertexStopName(ride_from));
+        const std::string e_to(GetVertexStopName(e.to));
+        route_info.items.push_back(
+          StopItem{e_from, static_cast<double>(bus_wait_time_)});
+        route_info.items.push_back(
+          BusItem{GetEdgeBusName(edge_id), e_from, e_to,
+                  ride_span, ToMinutes(ride_weight)});
+      }
     }
-    router_->ReleaseRoute(route->id);
     return route_info;
   }
 
+  // Vertex of the stop, std::nullopt for unknown names
+  std::optional<size_t> GetStopId(std::string_view stop_name) const {
+    const auto stop_id = stop_names_.Find(stop_name);
+    if (!stop_id) {
+      return std::nullopt;
+    }
+    return stop_vertices_[*stop_id];
+  }
+
+  // Times of routes from one stop to many, equal to BuildRoute total times
+  std::vector<std::optional<double>> BuildRouteTimes(
+      const std::string& from, const std::vector<std::string>& to) {
+    std::vector<Graph::VertexId> targets;
+    targets.reserve(to.size());
+    for (const auto& stop_name : to) {
+      targets.push_back(GetStopVertex(stop_name));
+    }
+    if (raptor_) {
+      return raptor_->FindJourneyTimes(GetStopVertex(from), targets);
+    }
+    return ToMinutes(router_->BuildRouteWeights(GetStopVertex(from), targets,
+                                                GetQueryState()));
+  }
+
+  // Same for many origins, a row of times per origin
+  std::vector<std::vector<std::optional<double>>> BuildRouteTimesTable(
+      const std::vector<std::string>& from,
+      const std::vector<std::string>& to) {
+    std::vector<Graph::VertexId> targets;
+    targets.reserve(to.size());
+    for (const auto& stop_name : to) {
+      targets.push_back(GetStopVertex(stop_name));
+    }
+    if (raptor_) {
+      std::vector<std::vector<std::optional<double>>> table;
+      table.reserve(from.size());
+      for (const auto& stop_name : from) {
+        table.push_back(raptor_->FindJourneyTimes(GetStopVertex(stop_name),
+                                                  targets));
+      }
+      return table;
+    }
+    std::vector<Graph::VertexId> sources;
+    sources.reserve(from.size());
+    for (const auto& stop_name : from) {
+      sources.push_back(GetStopVertex(stop_name));
+    }
+    std::vector<std::vector<std::optional<double>>> table;
+    table.reserve(sources.size());
+    for (const auto& weights :
+         router_->BuildRouteWeightsTable(sources, targets, GetQueryState())) {
+      table.push_back(ToMinutes(weights));
+    }
+    return table;
+  }
+
+  // Stops with route time up to max_time, the origin included,
+  // ordered by time and then by name
+  std::vector<std::pair<std::string, double>> FindReachableStops(
+      const std::string& from, double max_time) {
+    std::vector<std::pair<std::string, double>> reachable;
+    if (raptor_) {
+      std::vector<Graph::VertexId> targets(vertex_stops_.size());
+      std::iota(targets.begin(), targets.end(), 0);
+      const auto times = raptor_->FindJourneyTimes(GetStopVertex(from), targets);
+      for (const Graph::VertexId stop_v : targets) {
+        if (times[stop_v] && *times[stop_v] <= max_time) {
+          reachable.emplace_back(GetVertexStopName(stop_v), *times[stop_v]);
+        }
+      }
+    }
+    else {
+      if (!reachable_router_) {
+        reachable_router_ =
+          std::make_unique<Graph::DijkstraRouter<RouteWeight>>(*graph_);
+        reachable_state_ = reachable_router_->MakeQueryState();
+      }
+      const auto vertices = reachable_router_->FindVerticesWithin(
+          GetStopVertex(from), ToWeightLimit(max_time), *reachable_state_);
+      for (const auto& [vertex, weight] : vertices) {
+        if (IsStopVertex(vertex)) {
+          reachable.emplace_back(GetVertexStopName(vertex),
+                                 ToMinutes(weight));
+        }
+      }
+    }
+    std::sort(reachable.begin(), reachable.end(),
+              [](const auto& lhs, const auto& rhs) {
+                return std::tie(lhs.second, lhs.first) <
+                       std::tie(rhs.second, rhs.first);
+              });
+    return reachable;
+  }
+
+  // Longest route time weights can hold, Reachable budgets beyond it
+  // are clamped to it
+  double GetMaxRouteTime() const {
+    if constexpr (std::is_integral_v<RouteWeight>) {
+      return ToMinutes(std::numeric_limits<RouteWeight>::max() - 1);
+    }
+    else {
+      return std::numeric_limits<double>::max();
+    }
+  }
+
+  // Mapped route table next to the base file
+  static std::string GetRouteTableFile(const std::string& base_file) {
+    return base_file + ".routes";
+  }
+
+  size_t GetVertexCount() const {
+    return graph_->GetVertexCount();
+  }
+  size_t GetEdgeCount() const {
+    return graph_->GetEdgeCount();
+  }
+
+  double GetWalkTime(const NearbyStop& stop) const {
+    return stop.meters / pedestrian_velocity_;
+  }
+
   std::optional<RouteInfo> BuildRouteToCompany(const std::string& from,
                                                const NearbyStop& stop) {
     std::optional<RouteInfo> route_info;
@@ -180,65 +381,667 @@ class TransportRouter {
     else {
       route_info = RouteInfo();
     }
-    double walk_time = stop.meters / pedestrian_velocity_;
+    double walk_time = GetWalkTime(stop);
     route_info->total_time += walk_time;
     auto walk_item = WalkItem{stop.name, walk_time};
     route_info->items.push_back(walk_item);
     return route_info;
   }
 
-  TCatalog::Graph SerializeGraph() const {
+  // Mapped route table goes to its own file next to base_file
+  TCatalog::Graph SerializeGraph(const std::string& base_file) const {
     TCatalog::Graph g;
     for (size_t i = 0; i < graph_->GetEdgeCount(); i++) {
-      const Graph::Edge<double>& e = graph_->GetEdge(i);
+      const Graph::Edge<RouteWeight> e = graph_->GetEdge(i);
       TCatalog::Edge edge;
       edge.set_id_from(e.from);
       edge.set_id_to(e.to);
-      edge.set_w(e.weight);
+      if constexpr (std::is_integral_v<RouteWeight>) {
+        edge.set_ticks(e.weight);
+      }
+      else {
+        edge.set_w(e.weight);
+      }
       *g.add_edges() = edge;
       TCatalog::EdgeInfo edge_info;
-      edge_info.set_name(edge_to_info[i].first);
-      edge_info.set_span(edge_to_info[i].second);
+      edge_info.set_name(GetEdgeBusName(i));
+      edge_info.set_span(edge_infos_[i].span);
+      edge_info.set_meters(edge_infos_[i].meters);
+      edge_info.set_boarding(edge_infos_[i].boarding);
       *g.add_edges_info() = edge_info;
     }
-    for (size_t id = 0; id < id_to_stop.size(); id++) {
-      g.add_vertices(id_to_stop[id]);
+    // Trailing ride vertices are given by vertex_count only
+    size_t named_vertex_count = vertex_stops_.size();
+    while (named_vertex_count > 0 && !IsStopVertex(named_vertex_count - 1)) {
+      --named_vertex_count;
+    }
+    for (size_t id = 0; id < named_vertex_count; id++) {
+      g.add_vertices(IsStopVertex(id) ? std::string(GetVertexStopName(id))
+                                      : std::string());
+    }
+    if (graph_->GetVertexCount() != named_vertex_count) {
+      g.set_vertex_count(graph_->GetVertexCount());
+    }
+    g.set_ticks_per_minute(ticks_per_minute_);
+    g.set_edge_meters(has_edge_meters_);
+    // The only place make_base pays for routing preprocessing
+    if (router_type_ == RouterType::FloydWarshall &&
+        route_table_ != RouteTableStorage::Rebuild) {
+      std::optional<Graph::Router<RouteWeight>> table;
+      const Graph::Router<RouteWeight>& router =
+        repaired_table_ ? *repaired_table_ : table.emplace(*graph_, threads_);
+      if (route_table_ == RouteTableStorage::Embedded) {
+        *g.mutable_route_table() = router.SerializeRoutesInternalData();
+      }
+      else {
+        const uint64_t generation = Graph::MappedRouteTable::MakeGeneration();
+        router.WriteRoutesFile(GetRouteTableFile(base_file), generation);
+        g.set_route_table_generation(generation);
+      }
+    }
+    else if (router_type_ == RouterType::ContractionHierarchy) {
+      *g.mutable_hierarchy() =
+        Graph::ContractionHierarchy<RouteWeight>(*graph_).Serialize();
+    }
+    else if (router_type_ == RouterType::HubLabels) {
+      *g.mutable_hub_labels() =
+        Graph::HubLabeling<RouteWeight>(*graph_).Serialize();
+    }
+    else if (router_type_ == RouterType::PartitionOverlay) {
+      *g.mutable_partition_overlay() =
+        updated_overlay_
+          ? updated_overlay_->Serialize()
+          : Graph::PartitionOverlay<RouteWeight>(*graph_, vertex_points_)
+              .Serialize();
     }
 
     return g;
   }
 
  private:
-  double TimeBetweenStops(const std::vector<std::string>& bus_stops,
-                          const std::map<std::string, Stop>& stops_info,
-                          size_t idx_l,
-                          size_t idx_r) {
-    double t = 0;
+  // Bus and span of every edge, and what its weight is made of: meters
+  // of the ride and the wait when the edge boards a bus
+  struct EdgeInfo {
+    NameTable::Id bus_id;
+    uint32_t span;
+    int64_t meters;
+    bool boarding;
+  };
+
+  void ReadSettings(const TCatalog::RouterSettings &r) {
+    bus_wait_time_ = r.bus_wait_time();
+    bus_velocity_ = r.bus_velocity();
+    pedestrian_velocity_ = r.pedestrian_velocity();
+    router_type_ = static_cast<RouterType>(r.router_type());
+    route_table_ = static_cast<RouteTableStorage>(r.route_table());
+    threads_ = std::max<size_t>(r.threads(), 1);
+    graph_model_ = static_cast<GraphModel>(r.graph_model());
+    prune_parallel_edges_ = r.prune_parallel_edges();
+    SetWeightUnits();
+  }
+
+  void SetMetric(const RouterSettings& metric,
+                 std::vector<Graph::Edge<RouteWeight>>& edges) {
+    if (!has_edge_meters_) {
+      throw std::runtime_error(
+          "Base has no edge meters, rebuild it to change routing settings");
+    }
+    bus_wait_time_ = metric.bus_wait_time;
+    bus_velocity_ = metric.bus_velocity;
+    pedestrian_velocity_ = metric.pedestrian_velocity;
+    SetWeightUnits();
+    for (size_t edge_id = 0; edge_id < edges.size(); edge_id++) {
+      edges[edge_id].weight = GetEdgeWeight(edge_infos_[edge_id]);
+    }
+  }
+
+  // Made with the first query, TransportRouter queries run one at a time
+  Graph::QueryState& GetQueryState() {
+    if (!query_state_) {
+      query_state_ = router_->MakeQueryState();
+    }
+    return *query_state_;
+  }
+
+  void SetWeightUnits() {
+    if constexpr (std::is_integral_v<RouteWeight>) {
+      // A tick is the time to ride 1/60 m, so rides of whole meters and
+      // waits of whole minutes are exact whenever bus_velocity_ * 60,
+      // which is 1000 times the velocity in km/h, is a whole number, that
+      // is the velocity is a multiple of 0.001 km/h. Otherwise llround
+      // changes the tick scale and times are only approximate.
+      ticks_per_minute_ = std::llround(bus_velocity_ * 60);
+      if (ticks_per_minute_ == 0) {
+        throw std::runtime_error("Bus velocity too small for route weights");
+      }
+    }
+    wait_weight_ = ToWeight(bus_wait_time_);
+  }
+
+  // Edge weights: times that don't fit are errors, not wrapped values
+  RouteWeight ToWeight(double minutes) const {
+    if (!std::isfinite(minutes) || minutes < 0) {
+      throw std::runtime_error("Route time out of range");
+    }
+    if constexpr (std::is_integral_v<RouteWeight>) {
+      const double ticks = std::round(minutes * ticks_per_minute_);
+      if (ticks >= std::numeric_limits<RouteWeight>::max()) {
+        throw std::runtime_error("Route time out of range");
+      }
+      return static_cast<RouteWeight>(ticks);
+    }
+    else {
+      return minutes;
+    }
+  }
+
+  // Search budgets: saturated to [0, the largest reachable weight]
+  RouteWeight ToWeightLimit(double minutes) const {
+    if (!(minutes > 0)) {
+      return 0;
+    }
+    if constexpr (std::is_integral_v<RouteWeight>) {
+      constexpr RouteWeight max_weight =
+        std::numeric_limits<RouteWeight>::max() - 1;
+      const double ticks = std::round(minutes * ticks_per_minute_);
+      return ticks >= max_weight ? max_weight
+                                 : static_cast<RouteWeight>(ticks);
+    }
+    else {
+      return minutes;
+    }
+  }
+
+  double ToMinutes(RouteWeight weight) const {
+    if constexpr (std::is_integral_v<RouteWeight>) {
+      return static_cast<double>(weight) / ticks_per_minute_;
+    }
+    else {
+      return weight;
+    }
+  }
+
+  std::vector<std::optional<double>> ToMinutes(
+      const std::vector<std::optional<RouteWeight>>& weights) const {
+    std::vector<std::optional<double>> times;
+    times.reserve(weights.size());
+    for (const auto& weight : weights) {
+      times.push_back(weight ? std::optional<double>(ToMinutes(*weight))
+                             : std::nullopt);
+    }
+    return times;
+  }
+
+  // Stop names and edge infos go to members, the edges are returned
+  std::vector<Graph::Edge<RouteWeight>> ReadGraph(const TCatalog::Graph &g,
+                                             size_t& vertex_count) {
+    vertex_count = g.vertex_count() ? g.vertex_count() : g.vertices_size();
+    if (g.ticks_per_minute() != ticks_per_minute_) {
+      throw std::runtime_error(
+          "Base was made with other edge weights, rebuild it or switch "
+          "FIXED_POINT_WEIGHTS");
+    }
+
+    vertex_stops_.assign(vertex_count, NameTable::NO_ID);
+    for (auto i = 0; i < g.vertices_size(); i++) {
+      if (!g.vertices(i).empty()) {
+        AddStopVertex(g.vertices(i), i);
+      }
+    }
+
+    std::vector<Graph::Edge<RouteWeight>> edges;
+    edges.reserve(g.edges_size());
+    for (auto i = 0; i < g.edges_size(); i++) {
+      const auto& e = g.edges(i);
+      if constexpr (std::is_integral_v<RouteWeight>) {
+        edges.emplace_back(e.id_from(), e.id_to(), e.ticks());
+      }
+      else {
+        edges.emplace_back(e.id_from(), e.id_to(), e.w());
+      }
+    }
+
+    edge_infos_.reserve(g.edges_info_size());
+    for (auto i = 0; i < g.edges_info_size(); i++) {
+      const auto& edge_info = g.edges_info(i);
+      edge_infos_.push_back(EdgeInfo{bus_names_.Add(edge_info.name()),
+                                     edge_info.span(),
+                                     static_cast<int64_t>(edge_info.meters()),
+                                     edge_info.boarding()});
+    }
+    has_edge_meters_ = g.edge_meters();
+    return edges;
+  }
+
+  // Stop vertices of make_base come first, ones added by update_base
+  // follow the ride vertices, which have no stops
+  bool IsStopVertex(size_t vertex) const {
+    return vertex < vertex_stops_.size() &&
+           vertex_stops_[vertex] != NameTable::NO_ID;
+  }
+
+  void AddStopVertex(std::string_view stop_name, size_t vertex) {
+    const NameTable::Id stop_id = stop_names_.Add(stop_name);
+    if (vertex_stops_.size() <= vertex) {
+      vertex_stops_.resize(vertex + 1, NameTable::NO_ID);
+    }
+    vertex_stops_[vertex] = stop_id;
+    if (stop_vertices_.size() <= stop_id) {
+      stop_vertices_.resize(stop_id + 1);
+    }
+    stop_vertices_[stop_id] = vertex;
+  }
+
+  // Names are known to Database before they get here
+  size_t GetStopVertex(std::string_view stop_name) const {
+    const auto vertex = GetStopId(stop_name);
+    if (!vertex) {
+      throw std::runtime_error("Unknown stop " + std::string(stop_name));
+    }
+    return *vertex;
+  }
+
+  std::string_view GetVertexStopName(size_t vertex) const {
+    return stop_names_.GetName(vertex_stops_[vertex]);
+  }
+
+  std::string GetEdgeBusName(size_t edge_id) const {
+    return std::string(bus_names_.GetName(edge_infos_[edge_id].bus_id));
+  }
+
+  RouterPtr MakeRouter() const {
+    switch (router_type_) {
+      case RouterType::FloydWarshall:
+        return std::make_unique<Graph::Router<RouteWeight>>(*graph_, threads_);
+      case RouterType::Dijkstra:
+        return std::make_unique<Graph::DijkstraRouter<RouteWeight>>(*graph_);
+      case RouterType::ContractionHierarchy:
+        return std::make_unique<Graph::ContractionHierarchy<RouteWeight>>(*graph_);
+      case RouterType::BidirectionalAStar:
+        return std::make_unique<Graph::BidirectionalAStar<RouteWeight>>(
+            *graph_, vertex_points_);
+      case RouterType::HubLabels:
+        return std::make_unique<Graph::HubLabeling<RouteWeight>>(*graph_);
+      case RouterType::PartitionOverlay:
+        return std::make_unique<Graph::PartitionOverlay<RouteWeight>>(
+            *graph_, vertex_points_);
+      case RouterType::Raptor:
+        throw std::runtime_error("Raptor doesn't route over the graph");
+    }
+    throw std::runtime_error("Unknown router type");
+  }
+
+  // Uses preprocessing results stored by make_base when there are any
+  RouterPtr LoadRouter(const TCatalog::Graph& g,
+                       const std::string& base_file) const {
+    if (router_type_ == RouterType::FloydWarshall && g.has_route_table()) {
+      return std::make_unique<Graph::Router<RouteWeight>>(*graph_,
+                                                     g.route_table());
+    }
+    if (router_type_ == RouterType::FloydWarshall &&
+        route_table_ == RouteTableStorage::Mapped) {
+      return std::make_unique<Graph::Router<RouteWeight>>(
+          *graph_, std::make_shared<const Graph::MappedRouteTable>(
+                       GetRouteTableFile(base_file),
+                       g.route_table_generation()));
+    }
+    if (router_type_ == RouterType::ContractionHierarchy &&
+        g.has_hierarchy()) {
+      return std::make_unique<Graph::ContractionHierarchy<RouteWeight>>(
+          *graph_, g.hierarchy());
+    }
+    if (router_type_ == RouterType::HubLabels && g.has_hub_labels()) {
+      return std::make_unique<Graph::HubLabeling<RouteWeight>>(
+          *graph_, g.hub_labels());
+    }
+    if (router_type_ == RouterType::PartitionOverlay &&
+        g.has_partition_overlay()) {
+      return std::make_unique<Graph::PartitionOverlay<RouteWeight>>(
+          *graph_, g.partition_overlay(), true);
+    }
+    return MakeRouter();
+  }
+
+  // Preprocessing stored for other weights: the overlay partition doesn't
+  // depend on them and is only customized, the rest is made anew
+  RouterPtr CustomizeRouter(const TCatalog::Graph& g) const {
+    if (router_type_ == RouterType::PartitionOverlay &&
+        g.has_partition_overlay()) {
+      return std::make_unique<Graph::PartitionOverlay<RouteWeight>>(
+          *graph_, g.partition_overlay(), false);
+    }
+    return MakeRouter();
+  }
+
+  // Every bus direction becomes a stop array, two-way buses get the
+  // reversed one with meters of the way back
+  RaptorRouterPtr MakeRaptorRouter(
+      const std::map<std::string, Bus>& buses,
+      const std::map<std::string, Stop>& stops) const {
+    std::vector<Graph::TransitRoute> routes;
+    for (const auto& [k, bus] : buses) {
+      if (bus.GetStops().size() < 2) {
+        continue;
+      }
+      const BusTrack track = MakeBusTrack(bus, stops);
+      routes.push_back({bus.GetName(), track.stop_ids, track.forward_meters});
+      if (bus.GetType() == RouteType::TWOWAY) {
+        Graph::TransitRoute backward{bus.GetName(),
+                                     {track.stop_ids.rbegin(),
+                                      track.stop_ids.rend()},
+                                     {}};
+        backward.meters.reserve(track.backward_meters.size());
+        for (auto it = track.backward_meters.rbegin();
+             it != track.backward_meters.rend(); ++it) {
+          backward.meters.push_back(track.backward_meters.back() - *it);
+        }
+        routes.push_back(std::move(backward));
+      }
+    }
+    return std::make_unique<Graph::RaptorRouter>(
+        vertex_stops_.size(), std::move(routes), bus_wait_time_,
+        bus_velocity_);
+  }
+
+  std::optional<RouteInfo> BuildRaptorRoute(size_t from_v, size_t to_v) {
+    std::vector<Graph::RaptorRouter::Ride> rides;
+    const auto time = raptor_->FindJourney(from_v, to_v, rides);
+    if (time == std::nullopt) {
+      return std::nullopt;
+    }
+    RouteInfo route_info;
+    route_info.total_time = *time;
+    route_info.items.reserve(2 * rides.size());
+    for (const auto& ride : rides) {
+      const std::string ride_from(GetVertexStopName(ride.stop_from));
+      const std::string ride_to(GetVertexStopName(ride.stop_to));
+      route_info.items.push_back(
+        StopItem{ride_from, static_cast<double>(bus_wait_time_)});
+      route_info.items.push_back(
+        BusItem{raptor_->GetBusName(ride.route), ride_from, ride_to,
+                static_cast<int>(ride.span_count), ride.time});
+    }
+    return route_info;
+  }
+
+  // Ride vertices of the linear model take the point of their stop
+  std::vector<Graph::SpherePoint> MakeVertexPoints(
+      const std::map<std::string, Stop>& stops) const {
+    std::vector<Graph::SpherePoint> points(graph_->GetVertexCount());
+    for (size_t id = 0; id < vertex_stops_.size(); id++) {
+      if (!IsStopVertex(id)) {
+        continue;
+      }
+      const Stop& stop = stops.at(std::string(GetVertexStopName(id)));
+      points[id] = Graph::MakeSpherePoint(stop.GetLatitudeRad(),
+                                          stop.GetLongitudeRad());
+    }
+    for (size_t i = 0; i < graph_->GetEdgeCount(); i++) {
+      const Graph::Edge<RouteWeight> e = graph_->GetEdge(i);
+      if (IsStopVertex(e.from) && !IsStopVertex(e.to)) {
+        points[e.to] = points[e.from];
+      }
+      else if (!IsStopVertex(e.from) && IsStopVertex(e.to)) {
+        points[e.from] = points[e.to];
+      }
+    }
+    return points;
+  }
+
+  // Stops of a bus resolved once: vertex ids by position and cumulative
+  // meters from the first stop both ways, so any ride is a subtraction
+  struct BusTrack {
+    std::vector<size_t> stop_ids;
+    // Forward: riding i -> i + 1, backward: riding i + 1 -> i
+    std::vector<int64_t> forward_meters;
+    std::vector<int64_t> backward_meters;
+  };
+
+  BusTrack MakeBusTrack(const Bus& bus,
+                        const std::map<std::string, Stop>& stops) const {
+    const auto& bus_stops = bus.GetStops();
+    BusTrack track;
+    track.stop_ids.reserve(bus_stops.size());
+    track.forward_meters.reserve(bus_stops.size());
+    track.backward_meters.reserve(bus_stops.size());
+    const Stop* prev_stop = nullptr;
+    for (const auto& stop_name : bus_stops) {
+      const Stop& stop = stops.at(stop_name);
+      track.stop_ids.push_back(GetStopVertex(stop_name));
+      if (prev_stop == nullptr) {
+        track.forward_meters.push_back(0);
+        track.backward_meters.push_back(0);
+      }
+      else {
+        track.forward_meters.push_back(track.forward_meters.back() +
+                                       MapDistanceBetweenStops(*prev_stop, stop));
+        track.backward_meters.push_back(track.backward_meters.back() +
+                                        MapDistanceBetweenStops(stop, *prev_stop));
+      }
+      prev_stop = &stop;
+    }
+    return track;
+  }
+
+  int64_t MetersBetweenStops(const BusTrack& track,
+                             size_t idx_l,
+                             size_t idx_r) const {
     if (idx_l < idx_r) {
-      for (auto i = idx_l; i < idx_r; i++) {
-        const Stop& stop1 = stops_info.at(bus_stops[i]);
-        const Stop& stop2 = stops_info.at(bus_stops[i + 1]);
-        t += MapDistanceBetweenStops(stop1, stop2) / bus_velocity_;
+      return track.forward_meters[idx_r] - track.forward_meters[idx_l];
+    }
+    return track.backward_meters[idx_l] - track.backward_meters[idx_r];
+  }
+
+  // The only place bus_wait_time_ and bus_velocity_ get into edge weights
+  RouteWeight GetEdgeWeight(const EdgeInfo& edge_info) const {
+    const RouteWeight ride_weight = ToWeight(edge_info.meters / bus_velocity_);
+    if (!edge_info.boarding) {
+      return ride_weight;
+    }
+    if (ride_weight >= std::numeric_limits<RouteWeight>::max() - wait_weight_) {
+      throw std::runtime_error("Route time out of range");
+    }
+    return ride_weight + wait_weight_;
+  }
+
+  void AddEdge(std::vector<Graph::Edge<RouteWeight>>& edges,
+               size_t from, size_t to, const EdgeInfo& edge_info) {
+    edges.push_back(Graph::Edge<RouteWeight>{from, to,
+                                             GetEdgeWeight(edge_info)});
+    edge_infos_.push_back(edge_info);
+  }
+
+  // Edges of the buses in the chosen model are appended to edges,
+  // vertex_count grows by the ride vertices they need
+  void AddBusEdges(const std::map<std::string, Bus>& buses,
+                   const std::map<std::string, Stop>& stops,
+                   std::vector<Graph::Edge<RouteWeight>>& edges,
+                   size_t& vertex_count) {
+    // Raptor scans the buses themselves, the graph keeps stops only
+    if (router_type_ == RouterType::Raptor) {
+      return;
+    }
+    if (graph_model_ == GraphModel::Linear) {
+      AddLinearEdges(buses, stops, edges, vertex_count);
+    }
+    else {
+      AddPairwiseEdges(buses, stops, edges);
+    }
+  }
+
+  void AddPairwiseEdges(const std::map<std::string, Bus>& buses,
+                        const std::map<std::string, Stop>& stops,
+                        std::vector<Graph::Edge<RouteWeight>>& edges) {
+    for (const auto& [k, bus] : buses) {
+      const NameTable::Id bus_id = bus_names_.Add(bus.GetName());
+      const BusTrack track = MakeBusTrack(bus, stops);
+      size_t bus_stops_size = track.stop_ids.size();
+      RouteType type = bus.GetType();
+      if (type == RouteType::ROUND) {
+        for (size_t i = 0; i < bus_stops_size - 1; i++) {
+          for (size_t j = i + 1; j < bus_stops_size; j++) {
+            size_t idx_i = track.stop_ids[i];
+            size_t idx_j = track.stop_ids[j];
+            AddEdge(edges, idx_i, idx_j,
+                    EdgeInfo{bus_id, static_cast<uint32_t>(j - i),
+                             MetersBetweenStops(track, i, j), true});
+          }
+        }
+      }
+      else if (type == RouteType::TWOWAY) {
+        // -->
+        for (size_t i = 0; i < bus_stops_size - 1; i++) {
+          for (size_t j = i + 1; j < bus_stops_size; j++) {
+            size_t idx_i = track.stop_ids[i];
+            size_t idx_j = track.stop_ids[j];
+            AddEdge(edges, idx_i, idx_j,
+                    EdgeInfo{bus_id, static_cast<uint32_t>(j - i),
+                             MetersBetweenStops(track, i, j), true});
+          }
+        }
+        // <--
+        for (size_t i = 0; i < bus_stops_size - 1; i++) {
+          for (size_t j = i + 1; j < bus_stops_size; j++) {
+            size_t idx_j = track.stop_ids[j];
+            size_t idx_i = track.stop_ids[i];
+            AddEdge(edges, idx_j, idx_i,
+                    EdgeInfo{bus_id, static_cast<uint32_t>(j - i),
+                             MetersBetweenStops(track, j, i), true});
+          }
+        }
+      }
+      else {
+        throw std::runtime_error("Unknown bus type");
       }
     }
-    else if (idx_l > idx_r) {
-      for (auto i = idx_l; i > idx_r; i--) {
-        const Stop& stop1 = stops_info.at(bus_stops[i]);
-        const Stop& stop2 = stops_info.at(bus_stops[i - 1]);
-        t += MapDistanceBetweenStops(stop1, stop2) / bus_velocity_;
+  }
+
+  // Stop vertices come first, then every bus direction gets a chain of ride
+  // vertices, one per position. Boarding costs the wait, riding to the next
+  // stop costs its travel time and alighting is free, so a ride along k
+  // stops is k + 2 edges instead of a pairwise edge per (i, j).
+  void AddLinearEdges(const std::map<std::string, Bus>& buses,
+                      const std::map<std::string, Stop>& stops,
+                      std::vector<Graph::Edge<RouteWeight>>& edges,
+                      size_t& next_vertex) {
+    for (const auto& [k, bus] : buses) {
+      if (bus.GetStops().size() < 2) {
+        continue;
+      }
+      const NameTable::Id bus_id = bus_names_.Add(bus.GetName());
+      const BusTrack track = MakeBusTrack(bus, stops);
+      std::vector<size_t> positions(track.stop_ids.size());
+      std::iota(positions.begin(), positions.end(), 0);
+      RouteType type = bus.GetType();
+      if (type == RouteType::ROUND) {
+        AddRideChain(edges, bus_id, track, positions, next_vertex);
+      }
+      else if (type == RouteType::TWOWAY) {
+        AddRideChain(edges, bus_id, track, positions, next_vertex);
+        std::reverse(positions.begin(), positions.end());
+        AddRideChain(edges, bus_id, track, positions, next_vertex);
+      }
+      else {
+        throw std::runtime_error("Unknown bus type");
+      }
+    }
+  }
+
+  // Of edges with the same ends only the first lightest one stays, the one
+  // every router picks anyway, and the rest keep their order, so routes
+  // don't change. Edges before first_edge belong to a stored base and are
+  // never removed, its tables refer to them by id.
+  void PruneParallelEdges(std::vector<Graph::Edge<RouteWeight>>& edges,
+                          size_t first_edge) {
+    // (from, to) -> lightest edge so far
+    std::unordered_map<uint64_t, size_t> lightest;
+    std::vector<bool> is_kept(edges.size(), true);
+    for (size_t edge_id = 0; edge_id < edges.size(); edge_id++) {
+      const auto& e = edges[edge_id];
+      const uint64_t key = (static_cast<uint64_t>(e.from) << 32) | e.to;
+      const auto [it, inserted] = lightest.emplace(key, edge_id);
+      if (inserted) {
+        continue;
+      }
+      if (e.weight < edges[it->second].weight) {
+        if (it->second >= first_edge) {
+          is_kept[it->second] = false;
+        }
+        it->second = edge_id;
+      }
+      else if (edge_id >= first_edge) {
+        is_kept[edge_id] = false;
+      }
+    }
+
+    size_t kept_count = first_edge;
+    for (size_t edge_id = first_edge; edge_id < edges.size(); edge_id++) {
+      if (is_kept[edge_id]) {
+        edges[kept_count] = edges[edge_id];
+        edge_infos_[kept_count] = edge_infos_[edge_id];
+        ++kept_count;
+      }
+    }
+    edges.resize(kept_count);
+    edge_infos_.resize(kept_count);
+  }
+
+  // Ride vertices for bus stops visited in the order of positions
+  void AddRideChain(std::vector<Graph::Edge<RouteWeight>>& edges,
+                    NameTable::Id bus_id,
+                    const BusTrack& track,
+                    const std::vector<size_t>& positions,
+                    size_t& next_vertex) {
+    const size_t first_ride_v = next_vertex;
+    next_vertex += positions.size();
+    for (size_t i = 0; i < positions.size(); i++) {
+      const size_t stop_v = track.stop_ids[positions[i]];
+      const size_t ride_v = first_ride_v + i;
+      if (i + 1 < positions.size()) {
+        AddEdge(edges, stop_v, ride_v, EdgeInfo{bus_id, 0, 0, true});
+        AddEdge(edges, ride_v, ride_v + 1,
+                EdgeInfo{bus_id, 1,
+                         MetersBetweenStops(track, positions[i],
+                                            positions[i + 1]),
+                         false});
+      }
+      if (i > 0) {
+        AddEdge(edges, ride_v, stop_v, EdgeInfo{bus_id, 0, 0, false});
       }
     }
-    return t;
   }
 
   GraphPtr graph_;
   RouterPtr router_;
+  Graph::QueryStatePtr query_state_;
+  RaptorRouterPtr raptor_;
+  // Bounded searches of Reachable queries, whatever router_ is
+  std::unique_ptr<Graph::DijkstraRouter<RouteWeight>> reachable_router_;
+  Graph::QueryStatePtr reachable_state_;
   int bus_wait_time_;
   double bus_velocity_;
+  // Fixed-point weight units, 0 while weights are double minutes
+  uint64_t ticks_per_minute_ = 0;
+  RouteWeight wait_weight_ = 0;
   double pedestrian_velocity_;
-  std::unordered_map<std::string, size_t> stop_to_id;
-  std::vector<std::string> id_to_stop;
-  std::vector<std::pair<std::string, int>> edge_to_info;
+  RouterType router_type_;
+  RouteTableStorage route_table_;
+  size_t threads_;
+  GraphModel graph_model_;
+  bool prune_parallel_edges_ = false;
+  // False for bases made before edges kept their meters
+  bool has_edge_meters_ = true;
+  std::vector<Graph::SpherePoint> vertex_points_;
+  NameTable stop_names_;
+  NameTable bus_names_;
+  // Stop of every vertex, NO_ID for ride vertices, and back
+  std::vector<NameTable::Id> vertex_stops_;
+  std::vector<size_t> stop_vertices_;
+  std::vector<EdgeInfo> edge_infos_;
+  // Route table repaired by update_base, written instead of a new one
+  std::unique_ptr<Graph::Router<RouteWeight>> repaired_table_;
+  // Same for the stored partition with new vertices in it
+  std::unique_ptr<Graph::PartitionOverlay<RouteWeight>> updated_overlay_;
 };
 
 using TransportRouterPtr = std::unique_ptr<TransportRouter>;
@@ -11,4 +11,31 @@ diff -qZ "$root_dir/tests/test_t1_out" "$root_dir/tmp_out"
 "$main" process_requests "$root_dir/tests/test_t2_stat.json" > "$root_dir/tmp_out" && \
 diff -qZ "$root_dir/tests/test_t2_out" "$root_dir/tmp_out"
 
+"$main" make_base "$root_dir/tests/test_t4_base.json" && \
+"$main" process_requests "$root_dir/tests/test_t4_stat.json" > "$root_dir/tmp_out" && \
+diff -qZ "$root_dir/tests/test_t4_out" "$root_dir/tmp_out"
+
+"$main" make_base "$root_dir/tests/test_t4_base.json" && \
+"$main" process_requests "$root_dir/tests/test_t5_stat.json" > "$root_dir/tmp_out" && \
+diff -qZ "$root_dir/tests/test_t5_out" "$root_dir/tmp_out"
+
+# update_base must answer as make_base of the merged input does
+"$main" make_base "$root_dir/tests/test_t6_full_base.json" && \
+"$main" process_requests "$root_dir/tests/test_t6_stat.json" > "$root_dir/tmp_out" && \
+diff -qZ "$root_dir/tests/test_t6_out" "$root_dir/tmp_out"
+
+"$main" make_base "$root_dir/tests/test_t6_base.json" && \
+"$main" update_base "$root_dir/tests/test_t6_update.json" && \
+"$main" process_requests "$root_dir/tests/test_t6_stat.json" > "$root_dir/tmp_out" && \
+diff -qZ "$root_dir/tests/test_t6_out" "$root_dir/tmp_out"
+
+# Routing settings of the stat input must answer as a base made with them
+"$main" make_base "$root_dir/tests/test_t7_new_base.json" && \
+"$main" process_requests "$root_dir/tests/test_t7_stat.json" > "$root_dir/tmp_out" && \
+diff -qZ "$root_dir/tests/test_t7_out" "$root_dir/tmp_out"
+
+"$main" make_base "$root_dir/tests/test_t7_base.json" && \
+"$main" process_requests "$root_dir/tests/test_t7_stat.json" > "$root_dir/tmp_out" && \
+diff -qZ "$root_dir/tests/test_t7_out" "$root_dir/tmp_out"
+
 rm "$root_dir/tmp_out"
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "bus.h"
+#include "database.h"
+#include "json.h"
+#include "request.h"
+#include "stop.h"
+#include "transport_router.h"
+
+using namespace std;
+
+namespace {
+
+  // Synthetic city: stops on a grid or on rings around a center, buses
+  // are random walks between neighbouring stops
+  struct NetworkSettings {
+    int stop_count = 1000;
+    int bus_count = 100;
+    int route_length = 20;
+    double roundtrip_share = 0.5;
+    string geometry = "grid";
+    int seed = 1;
+  };
+
+  struct BenchSettings {
+    NetworkSettings network;
+    RouterSettings router_settings;
+    int query_count = 1000;
+  };
+
+  struct Network {
+    map<string, Stop> stops;
+    map<string, Bus> buses;
+  };
+
+  constexpr double STOP_SPACING = 400;  // meters
+  constexpr int RADIAL_SPOKES = 12;
+  constexpr double ROAD_FACTOR = 1.2;
+  constexpr double CENTER_LATITUDE = 55.75;
+  constexpr double CENTER_LONGITUDE = 37.6;
+  constexpr double METERS_PER_DEGREE = 111320;
+
+  int GetInt(const map<string, Json::Node>& m, const string& key,
+             int default_value) {
+    return m.count(key) ? m.at(key).AsInt() : default_value;
+  }
+
+  BenchSettings ReadBenchSettings(istream& is) {
+    const Json::Document document = Json::Load(is);
+    const auto& root = document.GetRoot().AsMap();
+    BenchSettings settings;
+
+    RoutingSettingsRequest routing_settings;
+    if (root.count("routing_settings")) {
+      routing_settings.ParseFromJson(root.at("routing_settings"));
+    }
+    else {
+      routing_settings.ParseFromJson(map<string, Json::Node>{
+          {"bus_wait_time", 6},
+          {"bus_velocity", 40},
+          {"pedestrian_velocity", 4}});
+    }
+    settings.router_settings = routing_settings.GetRouterSettings();
+
+    if (root.count("network")) {
+      const auto& network = root.at("network").AsMap();
+      NetworkSettings& ns = settings.network;
+      ns.stop_count = GetInt(network, "stop_count", ns.stop_count);
+      ns.bus_count = GetInt(network, "bus_count", ns.bus_count);
+      ns.route_length = GetInt(network, "route_length", ns.route_length);
+      if (network.count("roundtrip_share")) {
+        ns.roundtrip_share = network.at("roundtrip_share").AsDouble();
+      }
+      if (network.count("geometry")) {
+        ns.geometry = network.at("geometry").AsString();
+      }
+      ns.seed = GetInt(network, "seed", ns.seed);
+    }
+    settings.query_count = GetInt(root, "query_count", settings.query_count);
+
+    const NetworkSettings& ns = settings.network;
+    if (ns.stop_count < 2 || ns.bus_count < 1 || ns.route_length < 2) {
+      throw runtime_error("Network needs 2+ stops, a bus and 2+ stops a bus");
+    }
+    if (ns.geometry != "grid" && ns.geometry != "radial") {
+      throw runtime_error("Unknown network geometry " + ns.geometry);
+    }
+    return settings;
+  }
+
+  // Stop positions in meters from the center and neighbours of every stop
+  void MakeGeometry(const NetworkSettings& ns,
+                    vector<pair<double, double>>& points,
+                    vector<vector<int>>& neighbours) {
+    const int n = ns.stop_count;
+    points.resize(n);
+    neighbours.assign(n, {});
+    auto link = [&neighbours](int lhs, int rhs) {
+      neighbours[lhs].push_back(rhs);
+      neighbours[rhs].push_back(lhs);
+    };
+
+    if (ns.geometry == "grid") {
+      const int side = static_cast<int>(ceil(sqrt(n)));
+      for (int i = 0; i < n; ++i) {
+        points[i] = {(i % side) * STOP_SPACING, (i / side) * STOP_SPACING};
+        if (i % side > 0) {
+          link(i, i - 1);
+        }
+        if (i >= side) {
+          link(i, i - side);
+        }
+      }
+      return;
+    }
+
+    // Center first, then ring by ring, every ring has a stop per spoke
+    points[0] = {0, 0};
+    for (int i = 1; i < n; ++i) {
+      const int ring = (i - 1) / RADIAL_SPOKES + 1;
+      const int spoke = (i - 1) % RADIAL_SPOKES;
+      const double angle = 2 * M_PI * spoke / RADIAL_SPOKES;
+      points[i] = {ring * STOP_SPACING * cos(angle),
+                   ring * STOP_SPACING * sin(angle)};
+      link(i, ring == 1 ? 0 : i - RADIAL_SPOKES);
+      if (spoke > 0) {
+        link(i, i - 1);
+      }
+      if (spoke == RADIAL_SPOKES - 1) {
+        link(i, i - spoke);
+      }
+    }
+  }
+
+  Network MakeNetwork(const NetworkSettings& ns) {
+    vector<pair<double, double>> points;
+    vector<vector<int>> neighbours;
+    MakeGeometry(ns, points, neighbours);
+    auto stop_name = [](int i) { return "Stop " + to_string(i); };
+
+    mt19937 generator(ns.seed);
+    uniform_int_distribution<int> random_stop(0, ns.stop_count - 1);
+    uniform_real_distribution<double> random_share(0, 1);
+    vector<unordered_map<string, int>> distances(ns.stop_count);
+    auto add_distance = [&](int from, int to) {
+      const double meters = hypot(points[from].first - points[to].first,
+                                  points[from].second - points[to].second);
+      distances[from][stop_name(to)] =
+        max(1, static_cast<int>(lround(meters * ROAD_FACTOR)));
+    };
+
+    Network network;
+    for (int bus_idx = 0; bus_idx < ns.bus_count; ++bus_idx) {
+      vector<int> walk = {random_stop(generator)};
+      while (static_cast<int>(walk.size()) < ns.route_length) {
+        const auto& next = neighbours[walk.back()];
+        const int prev = walk.size() > 1 ? walk[walk.size() - 2] : -1;
+        vector<int> choices;
+        copy_if(next.begin(), next.end(), back_inserter(choices),
+                [prev](int stop) { return stop != prev; });
+        if (choices.empty()) {
+          choices = next;
+        }
+        walk.push_back(choices[generator() % choices.size()]);
+      }
+      const bool is_roundtrip = random_share(generator) < ns.roundtrip_share;
+      if (is_roundtrip) {
+        walk.push_back(walk.front());
+      }
+
+      vector<string> bus_stops;
+      for (size_t i = 0; i < walk.size(); ++i) {
+        bus_stops.push_back(stop_name(walk[i]));
+        if (i > 0) {
+          add_distance(walk[i - 1], walk[i]);
+          add_distance(walk[i], walk[i - 1]);
+        }
+      }
+      const string bus_name = "Bus " + to_string(bus_idx);
+      network.buses.emplace(
+          bus_name, Bus(bus_name, move(bus_stops),
+                        is_roundtrip ? RouteType::ROUND : RouteType::TWOWAY));
+    }
+
+    const double longitude_meters =
+      METERS_PER_DEGREE * cos(CENTER_LATITUDE * M_PI / 180);
+    for (int i = 0; i < ns.stop_count; ++i) {
+      network.stops.emplace(
+          stop_name(i),
+          Stop(stop_name(i),
+               CENTER_LATITUDE + points[i].second / METERS_PER_DEGREE,
+               CENTER_LONGITUDE + points[i].first / longitude_meters,
+               move(distances[i])));
+    }
+    return network;
+  }
+
+  double MillisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count();
+  }
+
+  double Percentile(const vector<double>& sorted, double share) {
+    if (sorted.empty()) {
+      return 0;
+    }
+    return sorted[min(sorted.size() - 1,
+                      static_cast<size_t>(share * sorted.size()))];
+  }
+
+  void RunBench(const BenchSettings& settings) {
+    const Network network = MakeNetwork(settings.network);
+    cout << fixed << setprecision(3);
+    cout << "stops: " << network.stops.size()
+         << ", buses: " << network.buses.size() << "\n";
+
+    // make_base: the graph, then preprocessing stored in the base
+    auto start = chrono::steady_clock::now();
+    const TransportRouter builder(network.buses, network.stops,
+                                  settings.router_settings);
+    cout << "graph build: " << MillisecondsSince(start) << " ms\n";
+    cout << "vertices: " << builder.GetVertexCount()
+         << ", edges: " << builder.GetEdgeCount() << "\n";
+
+    // Only the mapped route table is written next to it, the pid keeps
+    // concurrent runs apart
+    const string base_file =
+      (filesystem::temp_directory_path() /
+       ("transport_catalog_bench_" + to_string(getpid()))).string();
+    start = chrono::steady_clock::now();
+    const TCatalog::Graph graph = builder.SerializeGraph(base_file);
+    cout << "base preprocessing: " << MillisecondsSince(start) << " ms\n";
+
+    // process_requests: the router from the base
+    start = chrono::steady_clock::now();
+    TransportRouter router(graph,
+                           SerializeRouterSettings(settings.router_settings),
+                           network.buses, network.stops, base_file);
+    cout << "router load: " << MillisecondsSince(start) << " ms\n";
+
+    mt19937 generator(settings.network.seed);
+    uniform_int_distribution<int> random_stop(0,
+                                              settings.network.stop_count - 1);
+    vector<double> latencies;
+    latencies.reserve(settings.query_count);
+    int found_count = 0;
+    for (int i = 0; i < settings.query_count; ++i) {
+      const string from = "Stop " + to_string(random_stop(generator));
+      const string to = "Stop " + to_string(random_stop(generator));
+      start = chrono::steady_clock::now();
+      const auto route = router.BuildRoute(from, to);
+      latencies.push_back(MillisecondsSince(start) * 1000);
+      found_count += route.has_value();
+    }
+    sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (const double latency : latencies) {
+      total += latency;
+    }
+    cout << "routes: " << settings.query_count << ", found: " << found_count
+         << "\n";
+    cout << "route latency: p50 " << Percentile(latencies, 0.5)
+         << " us, p99 " << Percentile(latencies, 0.99) << " us, mean "
+         << (latencies.empty() ? 0 : total / latencies.size()) << " us\n";
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // Kilobytes on Linux
+    cout << "peak rss: " << usage.ru_maxrss / 1024.0 << " MB\n";
+
+    remove(TransportRouter::GetRouteTableFile(base_file).c_str());
+  }
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  if (argc > 2) {
+    cerr << "Usage: ./bench <opt. settings file>\n";
+    return 5;
+  }
+  BenchSettings settings;
+  if (argc == 2) {
+    ifstream f(argv[1]);
+    settings = ReadBenchSettings(f);
+  }
+  else {
+    settings = ReadBenchSettings(cin);
+  }
+  RunBench(settings);
+  return 0;
+}
@@ -31,12 +31,19 @@ void Database::FillStopsNeighbours() {
   }
 }
 
-Database::Database(SerializationSettingsRequestPtr r) {
-  DeserializeDatabase(std::move(r));
+Database::Database(SerializationSettingsRequestPtr r,
+                   RoutingSettingsRequestPtr routing_settings) {
+  DeserializeDatabase(std::move(r), std::move(routing_settings));
 
   FillStopsNeighbours();
 }
 
+Database::Database(SerializationSettingsRequestPtr r,
+                   std::vector<RequestPtr> updates) {
+  output_file_ = r->GetFileName();
+  ExtendDatabase(std::move(r), std::move(updates));
+}
+
 void Database::PrepareRoutes() {
   trouter_ = std::make_unique<TransportRouter>(buses_,
                                                stops_,
@@ -107,28 +114,51 @@ std::optional<TransportRouter::RouteInfo>
 Database::BuildRouteToClosestCompany(const std::string from,
                                      const double start,
                                      const std::vector<Company>& candidates) {
-  std::optional<TransportRouter::RouteInfo> best;
+  // One search for all nearby stops, only the winner gets its items
+  std::vector<std::string> targets;
   for (const auto& company : candidates) {
     for (const auto& stop : company.nearby_stops) {
-      auto route = trouter_->BuildRouteToCompany(from, stop);
-      if (route) {
-        if (best && route->total_time > best->total_time) {
-          continue;
-        }
-        // check if company is open and add wait if not
-        double finish = std::fmod(start + route->total_time, 60.0 * 24 * 7);
-        double wait_time = company.WaitForCompanyOpen(finish);
-        if (wait_time > 0) {
-          route->items.push_back(TransportRouter::WaitItem{wait_time});
-          route->total_time += wait_time;
-        }
+      targets.push_back(stop.name);
+    }
+  }
+  const auto route_times = trouter_->BuildRouteTimes(from, targets);
+
+  const Company* best_company = nullptr;
+  const NearbyStop* best_stop = nullptr;
+  double best_time = 0;
+  size_t target_idx = 0;
+  for (const auto& company : candidates) {
+    for (const auto& stop : company.nearby_stops) {
+      const auto& route_time = route_times[target_idx++];
+      if (!route_time) {
+        continue;
+      }
+      double total_time = *route_time + trouter_->GetWalkTime(stop);
+      if (best_company && total_time > best_time) {
+        continue;
       }
-      if (route && (!best || route->total_time < best->total_time)) {
-        best = route;
-        best->company = company;
+      // check if company is open and add wait if not
+      double finish = std::fmod(start + total_time, 60.0 * 24 * 7);
+      total_time += company.WaitForCompanyOpen(finish);
+      if (!best_company || total_time < best_time) {
+        best_company = &company;
+        best_stop = &stop;
+        best_time = total_time;
       }
     }
   }
+  if (!best_company) {
+    return std::nullopt;
+  }
+
+  auto best = trouter_->BuildRouteToCompany(from, *best_stop);
+  double finish = std::fmod(start + best->total_time, 60.0 * 24 * 7);
+  double wait_time = best_company->WaitForCompanyOpen(finish);
+  if (wait_time > 0) {
+    best->items.push_back(TransportRouter::WaitItem{wait_time});
+    best->total_time += wait_time;
+  }
+  best->company = *best_company;
   return best;
 }
 
@@ -180,20 +210,42 @@ Database::ProcessQueries(const std::vector<RequestPtr>& requests) {
     else if (req_type == RequestType::QueryRouteRequest) {
       auto& request = static_cast<QueryRouteRequest&>(*req_ptr);
       response["request_id"] = Json::Node(request.GetId());
-      std::string from = request.GetFrom();
-      std::string to = request.GetTo();
+      const std::string& from = request.GetFrom();
+      const std::string& to = request.GetTo();
+
+      const auto from_id = trouter_->GetStopId(from);
+      const auto to_id = trouter_->GetStopId(to);
+      if (!from_id || !to_id) {
+        response["error_message"] = Json::Node(std::string("not found"));
+        responses.push_back(std::move(response));
+        continue;
+      }
+      const std::pair<size_t, size_t> cache_key{*from_id, *to_id};
+      const auto* cached = route_cache_.GetCapacity() > 0
+                             ? route_cache_.Find(cache_key)
+                             : nullptr;
+      if (cached) {
+        response.insert(cached->begin(), cached->end());
+        responses.push_back(std::move(response));
+        continue;
+      }
 
       std::optional<TransportRouter::RouteInfo> route =
-        trouter_->BuildRoute(from, to);
+        trouter_->BuildRoute(*from_id, *to_id);
 
+      std::map<std::string, Json::Node> answer;
       if (route == std::nullopt) {
-        response["error_message"] = Json::Node(std::string("not found"));
+        answer["error_message"] = Json::Node(std::string("not found"));
       }
       else {
-        response["total_time"] = Json::Node(route->total_time);
-        response["items"] = BuildRouteItemNodes(*route);
-        response["map"] = Quote(RenderRouteAsSvg(*route));
+        answer["total_time"] = Json::Node(route->total_time);
+        answer["items"] = BuildRouteItemNodes(*route);
+        answer["map"] = Quote(RenderRouteAsSvg(*route));
+      }
+      if (route_cache_.GetCapacity() > 0) {
+        route_cache_.Insert(cache_key, answer);
       }
+      response.merge(answer);
       responses.push_back(std::move(response));
     }
     else if (req_type == RequestType::QueryMapRequest) {
@@ -202,6 +254,62 @@ Database::ProcessQueries(const std::vector<RequestPtr>& requests) {
       response["map"] = Quote(RenderAsSvg());
       responses.push_back(std::move(response));
     }
+    else if (req_type == RequestType::QueryMatrixRequest) {
+      auto& request = static_cast<QueryMatrixRequest&>(*req_ptr);
+      response["request_id"] = Json::Node(request.GetId());
+      const auto is_unknown = [this](const std::string& stop_name) {
+        return stops_.count(stop_name) == 0;
+      };
+      if (std::any_of(request.GetFrom().begin(), request.GetFrom().end(),
+                      is_unknown) ||
+          std::any_of(request.GetTo().begin(), request.GetTo().end(),
+                      is_unknown)) {
+        response["error_message"] = Json::Node(std::string("not found"));
+        responses.push_back(std::move(response));
+        continue;
+      }
+      const auto times = trouter_->BuildRouteTimesTable(request.GetFrom(),
+                                                        request.GetTo());
+      std::vector<Json::Node> rows;
+      rows.reserve(times.size());
+      for (const auto& times_row : times) {
+        std::vector<Json::Node> row;
+        row.reserve(times_row.size());
+        for (const auto& time : times_row) {
+          row.push_back(time ? Json::Node(*time) : Json::Node(nullptr));
+        }
+        rows.push_back(std::move(row));
+      }
+      response["total_times"] = std::move(rows);
+      responses.push_back(std::move(response));
+    }
+    else if (req_type == RequestType::QueryReachableRequest) {
+      auto& request = static_cast<QueryReachableRequest&>(*req_ptr);
+      response["request_id"] = Json::Node(request.GetId());
+      const double max_time = request.GetMaxTime();
+      if (!std::isfinite(max_time) || max_time < 0) {
+        response["error_message"] = Json::Node(std::string("invalid max_time"));
+        responses.push_back(std::move(response));
+        continue;
+      }
+      if (stops_.count(request.GetFrom()) == 0) {
+        response["error_message"] = Json::Node(std::string("not found"));
+        responses.push_back(std::move(response));
+        continue;
+      }
+      std::vector<Json::Node> stops;
+      for (const auto& [stop_name, time] :
+           trouter_->FindReachableStops(
+               request.GetFrom(),
+               std::min(max_time, trouter_->GetMaxRouteTime()))) {
+        std::map<std::string, Json::Node> node;
+        node["stop_name"] = Json::Node(stop_name);
+        node["time"] = Json::Node(time);
+        stops.push_back(std::move(node));
+      }
+      response["stops"] = std::move(stops);
+      responses.push_back(std::move(response));
+    }
     else if (req_type == RequestType::QueryCompanyRequest) {
       auto& request = static_cast<QueryCompanyRequest&>(*req_ptr);
       response["request_id"] = Json::Node(request.GetId());
@@ -382,6 +490,48 @@ void Database::UpdateDatabase(std::vector<RequestPtr> requests) {
   }
 }
 
+// The base is only appended to, so stops and buses must be new. Stops
+// already on the map keep their places: new ones are projected with the
+// stored zoom, the compressed layout needs a full make_base.
+void Database::AppendToDatabase(std::vector<RequestPtr> requests,
+                                std::vector<std::string>& new_stops,
+                                std::map<std::string, Bus>& new_buses) {
+  std::vector<std::string> new_bus_names;
+  for (const auto& req_ptr : requests) {
+    RequestType req_type = req_ptr->GetType();
+    if (req_type == RequestType::UpdateBusRequest) {
+      const std::string name =
+        static_cast<const UpdateBusRequest&>(*req_ptr).GetName();
+      if (buses_.count(name) ||
+          std::count(new_bus_names.begin(), new_bus_names.end(), name)) {
+        throw std::runtime_error("Bus " + name + " is already in the base");
+      }
+      new_bus_names.push_back(name);
+    }
+    else if (req_type == RequestType::UpdateStopRequest) {
+      const std::string name =
+        static_cast<const UpdateStopRequest&>(*req_ptr).GetName();
+      if (stops_.count(name) ||
+          std::count(new_stops.begin(), new_stops.end(), name)) {
+        throw std::runtime_error("Stop " + name + " is already in the base");
+      }
+      new_stops.push_back(name);
+    }
+  }
+  UpdateDatabase(std::move(requests));
+
+  for (const auto& name : new_stops) {
+    Stop& stop = stops_.at(name);
+    stop.SetX(GetXOnMap(stop));
+    stop.SetY(GetYOnMap(stop));
+  }
+  for (const auto& name : new_bus_names) {
+    Bus& bus = buses_.at(name);
+    bus.EvaluateRoute(stops_);
+    new_buses.insert({name, bus});
+  }
+}
+
 void Database::MarkBaseStops() {
   /*
    * 1. Через остановку проходит больше одного автобуса
@@ -660,9 +810,7 @@ void Database::UpdateRenderSettings() {
 }
 
 void Database::UpdateSettings(RoutingSettingsRequestPtr request) {
-  router_settings_.bus_wait_time = request->GetBusWaitTime();
-  router_settings_.bus_velocity = request->GetBusVelocity();
-  router_settings_.pedestrian_velocity = request->GetPedestrianVelocity();
+  router_settings_ = request->GetRouterSettings();
 }
 
 void Database::SaveToFile() {
@@ -216,10 +216,22 @@ void Database::BuildRubricsNum(const std::unordered_map<std::string,
 }
 
 
-void Database::DeserializeDatabase(SerializationSettingsRequestPtr r) {
-  TCatalog::TransportCatalog catalog;
-  catalog.ParseFromString(ReadFileData(r->GetFileName()));
+RouterSettings
+DeserializeRouterSettings(const TCatalog::RouterSettings& router_s) {
+  RouterSettings rs;
+  rs.bus_wait_time = router_s.bus_wait_time();
+  rs.bus_velocity = router_s.bus_velocity();
+  rs.pedestrian_velocity = router_s.pedestrian_velocity();
+  rs.router_type = static_cast<RouterType>(router_s.router_type());
+  rs.route_table = static_cast<RouteTableStorage>(router_s.route_table());
+  rs.threads = router_s.threads();
+  rs.graph_model = static_cast<GraphModel>(router_s.graph_model());
+  rs.route_cache_size = router_s.route_cache_size();
+  rs.prune_parallel_edges = router_s.prune_parallel_edges();
+  return rs;
+}
 
+void Database::DeserializeCatalog(const TCatalog::TransportCatalog& catalog) {
   map_settings_ = DeserializeMapSettings(catalog.map_settings());
 
   stops_ = DeserializeStops(catalog);
@@ -228,15 +240,53 @@ void Database::DeserializeDatabase(SerializationSettingsRequestPtr r) {
 
   stops_to_buses_ = DeserializeStopsToBuses(catalog);
 
-  trouter_ = std::make_unique<TransportRouter>(catalog.graph(),
-                                               catalog.router_settings());
-
   // aka DeserializeYellowPages()
   rubrics_ = DeserializeRubrics(catalog.yellow_pages());
   BuildRubricsNum(rubrics_);
   companies_ = DeserializeCompanies(catalog.yellow_pages());
 }
 
+void Database::DeserializeDatabase(SerializationSettingsRequestPtr r,
+                                   RoutingSettingsRequestPtr routing_settings) {
+  TCatalog::TransportCatalog catalog;
+  catalog.ParseFromString(ReadFileData(r->GetFileName()));
+
+  DeserializeCatalog(catalog);
+
+  std::optional<RouterSettings> metric;
+  if (routing_settings) {
+    metric = routing_settings->GetRouterSettings();
+  }
+  trouter_ = std::make_unique<TransportRouter>(catalog.graph(),
+                                               catalog.router_settings(),
+                                               buses_,
+                                               stops_,
+                                               r->GetFileName(),
+                                               metric);
+  route_cache_ = RouteCache(catalog.router_settings().route_cache_size());
+}
+
+void Database::ExtendDatabase(SerializationSettingsRequestPtr r,
+                              std::vector<RequestPtr> updates) {
+  TCatalog::TransportCatalog catalog;
+  catalog.ParseFromString(ReadFileData(r->GetFileName()));
+
+  DeserializeCatalog(catalog);
+  // Written back by SerializeDatabase as they were
+  router_settings_ = DeserializeRouterSettings(catalog.router_settings());
+
+  std::vector<std::string> new_stops;
+  std::map<std::string, Bus> new_buses;
+  AppendToDatabase(std::move(updates), new_stops, new_buses);
+
+  trouter_ = std::make_unique<TransportRouter>(catalog.graph(),
+                                               catalog.router_settings(),
+                                               new_buses,
+                                               stops_,
+                                               new_stops,
+                                               r->GetFileName());
+}
+
 /*****************************************************************************
  *                            SERIALIZE                                      *
  *****************************************************************************/
@@ -363,12 +413,21 @@ static void SerializeMapSettings(TCatalog::TransportCatalog& tc,
   tc_ms->set_zoom_coef(ms.zoom_coef);
 }
 
-static void SerializeRouterSettings(TCatalog::TransportCatalog& tc,
-                                    const RouterSettings& rs) {
-  TCatalog::RouterSettings* router_s = tc.mutable_router_settings();
-  router_s->set_bus_wait_time(rs.bus_wait_time);
-  router_s->set_bus_velocity(rs.bus_velocity);
-  router_s->set_pedestrian_velocity(rs.pedestrian_velocity);
+TCatalog::RouterSettings SerializeRouterSettings(const RouterSettings& rs) {
+  TCatalog::RouterSettings router_s;
+  router_s.set_bus_wait_time(rs.bus_wait_time);
+  router_s.set_bus_velocity(rs.bus_velocity);
+  router_s.set_pedestrian_velocity(rs.pedestrian_velocity);
+  router_s.set_router_type(
+      TCatalog::RouterSettings::RouterType(rs.router_type));
+  router_s.set_route_table(
+      TCatalog::RouterSettings::RouteTableStorage(rs.route_table));
+  router_s.set_threads(rs.threads);
+  router_s.set_graph_model(
+      TCatalog::RouterSettings::GraphModel(rs.graph_model));
+  router_s.set_route_cache_size(rs.route_cache_size);
+  router_s.set_prune_parallel_edges(rs.prune_parallel_edges);
+  return router_s;
 }
 
 static YellowPages::Company SerializeCompany(const Company& company) {
@@ -449,9 +508,9 @@ void Database::SerializeDatabase() {
 
   SerializeMapSettings(catalog, map_settings_);
 
-  SerializeRouterSettings(catalog, router_settings_);
+  *catalog.mutable_router_settings() = SerializeRouterSettings(router_settings_);
 
-  *catalog.mutable_graph() = trouter_->SerializeGraph();
+  *catalog.mutable_graph() = trouter_->SerializeGraph(output_file_);
 
   // aka SerializeYellowPages()
   SerializeRubrics(catalog, rubrics_);
@@ -99,6 +99,13 @@ namespace Json {
     return Node(value);
   }
 
+  // Same as for boolean, "null" is the only value starting with n
+  static Node LoadNull(istream& input) {
+    char c;
+    input >> c >> c >> c >> c;
+    return Node(nullptr);
+  }
+
   static Node LoadNode(istream& input) {
     char c;
     input >> c;
@@ -114,6 +121,9 @@ namespace Json {
       if (c == 't' || c == 'f') {
         return LoadBool(input);
       }
+      if (c == 'n') {
+        return LoadNull(input);
+      }
       return LoadIntOrDouble(input);
     }
   }
@@ -162,6 +172,9 @@ namespace Json {
       const auto node_double = node.AsDouble();
       os << setprecision(6) << node_double;
     }
+    else if (node.IsNull()) {
+      os << "null";
+    }
     return os.str();
   }
 }  // namespace Json
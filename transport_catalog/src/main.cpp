@@ -1,4 +1,5 @@
 #include <fstream>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -98,6 +99,40 @@ ParseQueryMapRequest(const map<string, Json::Node>& request_m) {
   return res;
 }
 
+static vector<string> ParseStopNames(const Json::Node& node) {
+  vector<string> stop_names;
+  stop_names.reserve(node.AsArray().size());
+  for (const auto& name : node.AsArray()) {
+    stop_names.push_back(name.AsString());
+  }
+  return stop_names;
+}
+
+static QueryMatrixRequestPtr
+ParseQueryMatrixRequest(const map<string, Json::Node>& request_m) {
+  QueryMatrixRequestPtr res = make_unique<QueryMatrixRequest>();
+  res->SetId(request_m.at("id").AsInt());
+  res->SetFrom(ParseStopNames(request_m.at("from")));
+  res->SetTo(ParseStopNames(request_m.at("to")));
+  return res;
+}
+
+static QueryReachableRequestPtr
+ParseQueryReachableRequest(const map<string, Json::Node>& request_m) {
+  QueryReachableRequestPtr res = make_unique<QueryReachableRequest>();
+  res->SetId(request_m.at("id").AsInt());
+  res->SetFrom(request_m.at("from").AsString());
+  const auto& max_time = request_m.at("max_time");
+  // Anything but a number is answered as an invalid max_time
+  if (holds_alternative<int>(max_time) || holds_alternative<double>(max_time)) {
+    res->SetMaxTime(max_time.AsDouble());
+  }
+  else {
+    res->SetMaxTime(numeric_limits<double>::quiet_NaN());
+  }
+  return res;
+}
+
 static QueryCompanyRequestPtr
 ParseQueryCompanyRequest(const map<string, Json::Node>& request_m) {
   QueryCompanyRequestPtr res = make_unique<QueryCompanyRequest>();
@@ -127,6 +162,12 @@ static RequestPtr ParseStatRequest(const Json::Node& request) {
   else if (type == "Map") {
     return ParseQueryMapRequest(request_m);
   }
+  else if (type == "Matrix") {
+    return ParseQueryMatrixRequest(request_m);
+  }
+  else if (type == "Reachable") {
+    return ParseQueryReachableRequest(request_m);
+  }
   else if (type == "FindCompanies") {
     return ParseQueryCompanyRequest(request_m);
   }
@@ -212,7 +253,30 @@ static StatInputStruct ReadStatRequests(istream& is = cin) {
   SerializationSettingsRequestPtr serialization_settings =
     ParseSerializationSettingsRequest(serialization_request);
 
-  return {move(queries), move(serialization_settings)};
+  RoutingSettingsRequestPtr routing_settings;
+  if (requests.count("routing_settings")) {
+    routing_settings =
+      ParseRoutingSettingsRequest(requests.at("routing_settings"));
+  }
+
+  return {move(queries), move(serialization_settings),
+          move(routing_settings)};
+}
+
+static UpdateInputStruct ReadUpdateRequests(istream& is = cin) {
+  vector<RequestPtr> updates;
+  Json::Document in_document = Json::Load(is);
+  const auto& requests = in_document.GetRoot().AsMap();
+  const auto& base_requests = requests.at("base_requests").AsArray();
+  updates.reserve(base_requests.size());
+  for (const auto& request : base_requests) {
+    updates.push_back(ParseBaseRequest(request));
+  }
+  const auto& serialization_request = requests.at("serialization_settings");
+  SerializationSettingsRequestPtr serialization_settings =
+    ParseSerializationSettingsRequest(serialization_request);
+
+  return {move(updates), move(serialization_settings)};
 }
 
 static void PrintResponses(const vector<Response>& responses,
@@ -222,7 +286,8 @@ static void PrintResponses(const vector<Response>& responses,
 
 int main(int argc, const char* argv[]) {
   if (argc < 2 || argc > 3) {
-    cerr << "Usage: ./main [make_base|process_requests] <opt. input file>\n";
+    cerr << "Usage: ./main [make_base|update_base|process_requests] "
+            "<opt. input file>\n";
     return 5;
   }
   const string_view mode(argv[1]);
@@ -238,6 +303,19 @@ int main(int argc, const char* argv[]) {
     Database db(input_base);
     db.SaveToFile();
   }
+  else if (mode == "update_base") {
+    UpdateInputStruct input_update;
+    if (argc == 3) {
+      std::fstream f(argv[2]);
+      input_update = ReadUpdateRequests(f);
+    }
+    else {
+      input_update = ReadUpdateRequests();
+    }
+    Database db(move(input_update.serialization_settings),
+                move(input_update.updates));
+    db.SaveToFile();
+  }
   else if (mode == "process_requests") {
     StatInputStruct input_stat;
     if (argc == 3) {
@@ -247,11 +325,18 @@ int main(int argc, const char* argv[]) {
     else {
       input_stat = ReadStatRequests();
     }
-    Database db(move(input_stat.serialization_settings));
+    Database db(move(input_stat.serialization_settings),
+                move(input_stat.routing_settings));
 
     // Process stat requests
     auto responses = db.ProcessQueries(input_stat.queries);
     PrintResponses(responses);
+
+    const RouteCache& route_cache = db.GetRouteCache();
+    if (route_cache.GetCapacity() > 0) {
+      cerr << "Route cache: " << route_cache.GetHits() << " hits, "
+           << route_cache.GetMisses() << " misses\n";
+    }
   }
   return 0;
 }
@@ -0,0 +1,128 @@
+#include "mapped_route_table.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Graph {
+
+  namespace {
+
+    constexpr char MAGIC[8] = {'T', 'C', 'R', 'O', 'U', 'T', 'E', 'S'};
+    constexpr uint32_t VERSION = 2;
+
+    // Weights start right after it and stay 8-byte aligned
+    struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t weight_size;
+      uint64_t vertex_count;
+      uint64_t edge_count;
+      uint64_t generation;
+    };
+    static_assert(sizeof(Header) == 40);
+
+    size_t GetFileSize(size_t vertex_count, size_t weight_size) {
+      const size_t cell_count = vertex_count * vertex_count;
+      return sizeof(Header) + cell_count * (weight_size + sizeof(uint32_t));
+    }
+
+  }  // namespace
+
+  MappedRouteTable::MappedRouteTable(const std::string& file_name,
+                                     uint64_t generation) {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Can't open route table " + file_name);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<size_t>(file_stat.st_size) < sizeof(Header)) {
+      close(fd);
+      throw std::runtime_error("Route table " + file_name + " is broken");
+    }
+    size_ = file_stat.st_size;
+    data_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid without the descriptor
+    close(fd);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      throw std::runtime_error("Can't map route table " + file_name);
+    }
+
+    Header header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION ||
+        size_ != GetFileSize(header.vertex_count, header.weight_size)) {
+      munmap(data_, size_);
+      throw std::runtime_error("Route table " + file_name + " is broken");
+    }
+    if (header.generation != generation) {
+      munmap(data_, size_);
+      throw std::runtime_error("Route table " + file_name +
+                               " was written for another base");
+    }
+    vertex_count_ = header.vertex_count;
+    edge_count_ = header.edge_count;
+    weight_size_ = header.weight_size;
+  }
+
+  MappedRouteTable::~MappedRouteTable() {
+    munmap(data_, size_);
+  }
+
+  const void* MappedRouteTable::GetWeights() const {
+    return static_cast<const char*>(data_) + sizeof(Header);
+  }
+
+  const uint32_t* MappedRouteTable::GetPrevEdges() const {
+    return reinterpret_cast<const uint32_t*>(
+        static_cast<const char*>(GetWeights()) +
+        vertex_count_ * vertex_count_ * weight_size_);
+  }
+
+  uint64_t MappedRouteTable::MakeGeneration() {
+    std::random_device device;
+    std::uniform_int_distribution<uint64_t> distribution(1);
+    return distribution(device);
+  }
+
+  void MappedRouteTable::Write(const std::string& file_name,
+                               uint64_t generation,
+                               size_t vertex_count, size_t edge_count,
+                               size_t weight_size, const void* weights,
+                               const uint32_t* prev_edges) {
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.weight_size = weight_size;
+    header.vertex_count = vertex_count;
+    header.edge_count = edge_count;
+    header.generation = generation;
+
+    const std::string tmp_file_name = file_name + ".tmp";
+    {
+      std::ofstream out(tmp_file_name, std::ios::binary | std::ios::trunc);
+      const size_t cell_count = vertex_count * vertex_count;
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(static_cast<const char*>(weights), cell_count * weight_size);
+      out.write(reinterpret_cast<const char*>(prev_edges),
+                cell_count * sizeof(uint32_t));
+      if (!out) {
+        throw std::runtime_error("Can't write route table " + tmp_file_name);
+      }
+    }
+    if (std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0) {
+      throw std::runtime_error("Can't write route table " + file_name);
+    }
+  }
+
+}  // namespace Graph
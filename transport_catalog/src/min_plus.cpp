@@ -0,0 +1,209 @@
+#include "min_plus.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MIN_PLUS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Graph {
+
+  namespace {
+
+    using RelaxRowFunction = void (*)(double*, uint32_t*,
+                                      const double*, const uint32_t*,
+                                      size_t, double, uint32_t, uint32_t);
+    using RelaxRowFixedFunction = void (*)(uint32_t*, uint32_t*,
+                                           const uint32_t*, const uint32_t*,
+                                           size_t, uint32_t, uint32_t,
+                                           uint32_t);
+
+#ifdef MIN_PLUS_X86
+    // Four cells per step: weights are compared as doubles, the mask is
+    // narrowed to 32-bit lanes to blend prev edges
+    __attribute__((target("avx2")))
+    void RelaxRowAvx2(double* from_weights,
+                      uint32_t* from_prev_edges,
+                      const double* through_weights,
+                      const uint32_t* through_prev_edges,
+                      size_t count,
+                      double weight_from,
+                      uint32_t prev_edge_from,
+                      uint32_t no_edge) {
+      const __m256d weight_from_v = _mm256_set1_pd(weight_from);
+      const __m128i prev_edge_from_v = _mm_set1_epi32(prev_edge_from);
+      const __m128i no_edge_v = _mm_set1_epi32(no_edge);
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+        const __m256d candidate = _mm256_add_pd(
+            weight_from_v, _mm256_loadu_pd(through_weights + i));
+        const __m256d current = _mm256_loadu_pd(from_weights + i);
+        const __m256d better = _mm256_cmp_pd(candidate, current, _CMP_LT_OQ);
+        if (_mm256_movemask_pd(better) == 0) {
+          continue;
+        }
+        _mm256_storeu_pd(from_weights + i,
+                         _mm256_blendv_pd(current, candidate, better));
+
+        const __m256 better_ps = _mm256_castpd_ps(better);
+        const __m128i better_32 = _mm_castps_si128(_mm_shuffle_ps(
+            _mm256_castps256_ps128(better_ps),
+            _mm256_extractf128_ps(better_ps, 1),
+            _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i through_prev = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(through_prev_edges + i));
+        const __m128i new_prev = _mm_blendv_epi8(
+            through_prev, prev_edge_from_v,
+            _mm_cmpeq_epi32(through_prev, no_edge_v));
+        __m128i* from_prev = reinterpret_cast<__m128i*>(from_prev_edges + i);
+        _mm_storeu_si128(from_prev, _mm_blendv_epi8(
+            _mm_loadu_si128(from_prev), new_prev, better_32));
+      }
+      RelaxRowMinPlusScalar(from_weights + i, from_prev_edges + i,
+                            through_weights + i, through_prev_edges + i,
+                            count - i, weight_from, prev_edge_from, no_edge);
+    }
+
+    // Two cells per step, SSE2 is always there on x86-64
+    void RelaxRowSse2(double* from_weights,
+                      uint32_t* from_prev_edges,
+                      const double* through_weights,
+                      const uint32_t* through_prev_edges,
+                      size_t count,
+                      double weight_from,
+                      uint32_t prev_edge_from,
+                      uint32_t no_edge) {
+      const __m128d weight_from_v = _mm_set1_pd(weight_from);
+      const __m128i prev_edge_from_v = _mm_set1_epi32(prev_edge_from);
+      const __m128i no_edge_v = _mm_set1_epi32(no_edge);
+      size_t i = 0;
+      for (; i + 2 <= count; i += 2) {
+        const __m128d candidate = _mm_add_pd(
+            weight_from_v, _mm_loadu_pd(through_weights + i));
+        const __m128d current = _mm_loadu_pd(from_weights + i);
+        const __m128d better = _mm_cmplt_pd(candidate, current);
+        if (_mm_movemask_pd(better) == 0) {
+          continue;
+        }
+        _mm_storeu_pd(from_weights + i,
+                      _mm_or_pd(_mm_and_pd(better, candidate),
+                                _mm_andnot_pd(better, current)));
+
+        const __m128i better_32 = _mm_shuffle_epi32(
+            _mm_castpd_si128(better), _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128i through_prev = _mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(through_prev_edges + i));
+        const __m128i no_prev = _mm_cmpeq_epi32(through_prev, no_edge_v);
+        const __m128i new_prev = _mm_or_si128(
+            _mm_and_si128(no_prev, prev_edge_from_v),
+            _mm_andnot_si128(no_prev, through_prev));
+        __m128i* from_prev = reinterpret_cast<__m128i*>(from_prev_edges + i);
+        const __m128i current_prev = _mm_loadl_epi64(from_prev);
+        _mm_storel_epi64(from_prev, _mm_or_si128(
+            _mm_and_si128(better_32, new_prev),
+            _mm_andnot_si128(better_32, current_prev)));
+      }
+      RelaxRowMinPlusScalar(from_weights + i, from_prev_edges + i,
+                            through_weights + i, through_prev_edges + i,
+                            count - i, weight_from, prev_edge_from, no_edge);
+    }
+
+    // Eight cells per step. There is no unsigned compare, a <= b is
+    // max(a, b) == b, and a sum that wrapped is below weight_from.
+    __attribute__((target("avx2")))
+    void RelaxRowFixedAvx2(uint32_t* from_weights,
+                           uint32_t* from_prev_edges,
+                           const uint32_t* through_weights,
+                           const uint32_t* through_prev_edges,
+                           size_t count,
+                           uint32_t weight_from,
+                           uint32_t prev_edge_from,
+                           uint32_t no_edge) {
+      const __m256i weight_from_v = _mm256_set1_epi32(weight_from);
+      const __m256i prev_edge_from_v = _mm256_set1_epi32(prev_edge_from);
+      const __m256i no_edge_v = _mm256_set1_epi32(no_edge);
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+        const __m256i candidate = _mm256_add_epi32(
+            weight_from_v, _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(through_weights + i)));
+        __m256i* from = reinterpret_cast<__m256i*>(from_weights + i);
+        const __m256i current = _mm256_loadu_si256(from);
+        const __m256i no_overflow = _mm256_cmpeq_epi32(
+            _mm256_max_epu32(candidate, weight_from_v), candidate);
+        const __m256i not_better = _mm256_cmpeq_epi32(
+            _mm256_max_epu32(candidate, current), candidate);
+        const __m256i better = _mm256_andnot_si256(not_better, no_overflow);
+        if (_mm256_testz_si256(better, better)) {
+          continue;
+        }
+        _mm256_storeu_si256(from,
+                            _mm256_blendv_epi8(current, candidate, better));
+
+        const __m256i through_prev = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(through_prev_edges + i));
+        const __m256i new_prev = _mm256_blendv_epi8(
+            through_prev, prev_edge_from_v,
+            _mm256_cmpeq_epi32(through_prev, no_edge_v));
+        __m256i* from_prev = reinterpret_cast<__m256i*>(from_prev_edges + i);
+        _mm256_storeu_si256(from_prev, _mm256_blendv_epi8(
+            _mm256_loadu_si256(from_prev), new_prev, better));
+      }
+      RelaxRowMinPlusScalar(from_weights + i, from_prev_edges + i,
+                            through_weights + i, through_prev_edges + i,
+                            count - i, weight_from, prev_edge_from, no_edge);
+    }
+#endif
+
+    RelaxRowFunction ChooseRelaxRow() {
+#ifdef MIN_PLUS_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")) {
+        return RelaxRowAvx2;
+      }
+      return RelaxRowSse2;
+#else
+      return RelaxRowMinPlusScalar<double>;
+#endif
+    }
+
+    RelaxRowFixedFunction ChooseRelaxRowFixed() {
+#ifdef MIN_PLUS_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")) {
+        return RelaxRowFixedAvx2;
+      }
+#endif
+      return RelaxRowMinPlusScalar<uint32_t>;
+    }
+
+  }  // namespace
+
+  void RelaxRowMinPlus(double* from_weights,
+                       uint32_t* from_prev_edges,
+                       const double* through_weights,
+                       const uint32_t* through_prev_edges,
+                       size_t count,
+                       double weight_from,
+                       uint32_t prev_edge_from,
+                       uint32_t no_edge) {
+    static const RelaxRowFunction relax_row = ChooseRelaxRow();
+    relax_row(from_weights, from_prev_edges, through_weights,
+              through_prev_edges, count, weight_from, prev_edge_from,
+              no_edge);
+  }
+
+  void RelaxRowMinPlus(uint32_t* from_weights,
+                       uint32_t* from_prev_edges,
+                       const uint32_t* through_weights,
+                       const uint32_t* through_prev_edges,
+                       size_t count,
+                       uint32_t weight_from,
+                       uint32_t prev_edge_from,
+                       uint32_t no_edge) {
+    static const RelaxRowFixedFunction relax_row = ChooseRelaxRowFixed();
+    relax_row(from_weights, from_prev_edges, through_weights,
+              through_prev_edges, count, weight_from, prev_edge_from,
+              no_edge);
+  }
+
+}  // namespace Graph
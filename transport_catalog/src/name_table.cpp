@@ -0,0 +1,65 @@
+#include "name_table.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+NameTable::Id NameTable::Add(std::string_view name) {
+  const size_t hash = std::hash<std::string_view>{}(name);
+  if (!slots_.empty()) {
+    const size_t slot = FindSlot(name, hash);
+    if (slots_[slot] != NO_ID) {
+      return slots_[slot];
+    }
+  }
+  if (storage_.size() + name.size() >= std::numeric_limits<uint32_t>::max() ||
+      GetSize() + 1 >= NO_ID) {
+    throw std::runtime_error("Too many names");
+  }
+
+  const Id id = GetSize();
+  storage_.append(name);
+  offsets_.push_back(storage_.size());
+  hashes_.push_back(hash);
+  // Load factor stays at most one half
+  if (2 * GetSize() > slots_.size()) {
+    Rehash(std::max<size_t>(16, 2 * slots_.size()));
+  }
+  else {
+    slots_[FindSlot(name, hash)] = id;
+  }
+  return id;
+}
+
+std::optional<NameTable::Id> NameTable::Find(std::string_view name) const {
+  if (slots_.empty()) {
+    return std::nullopt;
+  }
+  const Id id = slots_[FindSlot(name, std::hash<std::string_view>{}(name))];
+  if (id == NO_ID) {
+    return std::nullopt;
+  }
+  return id;
+}
+
+size_t NameTable::FindSlot(std::string_view name, size_t hash) const {
+  const size_t mask = slots_.size() - 1;
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    const Id id = slots_[slot];
+    if (id == NO_ID || (hashes_[id] == hash && GetName(id) == name)) {
+      return slot;
+    }
+  }
+}
+
+void NameTable::Rehash(size_t slot_count) {
+  slots_.assign(slot_count, NO_ID);
+  const size_t mask = slot_count - 1;
+  for (Id id = 0; id < GetSize(); ++id) {
+    size_t slot = hashes_[id] & mask;
+    while (slots_[slot] != NO_ID) {
+      slot = (slot + 1) & mask;
+    }
+    slots_[slot] = id;
+  }
+}
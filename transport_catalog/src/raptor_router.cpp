@@ -0,0 +1,169 @@
+#include "raptor_router.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace Graph {
+
+  namespace {
+
+    constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+    constexpr uint32_t NO_POSITION = std::numeric_limits<uint32_t>::max();
+
+  }  // namespace
+
+  RaptorRouter::RaptorRouter(size_t stop_count,
+                             std::vector<TransitRoute> routes,
+                             double wait_time, double velocity)
+      : stop_count_(stop_count),
+        routes_(std::move(routes)),
+        wait_time_(wait_time),
+        velocity_(velocity),
+        stop_routes_(stop_count) {
+    for (size_t route = 0; route < routes_.size(); ++route) {
+      const auto& stops = routes_[route].stops;
+      for (size_t position = 0; position < stops.size(); ++position) {
+        stop_routes_[stops[position]].push_back(
+            RouteVisit{static_cast<uint32_t>(route),
+                       static_cast<uint32_t>(position)});
+      }
+    }
+  }
+
+  double RaptorRouter::RideTime(const TransitRoute& route,
+                                size_t position_from,
+                                size_t position_to) const {
+    return (route.meters[position_to] - route.meters[position_from]) /
+           velocity_;
+  }
+
+  RaptorRouter::Rounds RaptorRouter::RunRounds(VertexId from,
+                                               VertexId target) const {
+    Rounds rounds;
+    auto& arrivals = rounds.arrivals;
+    arrivals.assign(1, std::vector<double>(stop_count_, UNREACHED));
+    rounds.labels.assign(1, std::vector<Label>(stop_count_,
+                                               Label{NO_ROUTE, 0, 0}));
+    arrivals[0][from] = 0;
+
+    std::vector<VertexId> marked_stops = {from};
+    std::vector<bool> is_marked(stop_count_);
+    // Earliest position of every queued route to scan from
+    std::vector<uint32_t> first_positions(routes_.size(), NO_POSITION);
+    std::vector<uint32_t> queued_routes;
+
+    while (!marked_stops.empty()) {
+      for (const VertexId stop : marked_stops) {
+        is_marked[stop] = false;
+        for (const auto& visit : stop_routes_[stop]) {
+          uint32_t& first_position = first_positions[visit.route];
+          if (first_position == NO_POSITION) {
+            queued_routes.push_back(visit.route);
+          }
+          first_position = std::min(first_position, visit.position);
+        }
+      }
+      marked_stops.clear();
+
+      arrivals.push_back(arrivals.back());
+      rounds.labels.emplace_back(stop_count_, Label{NO_ROUTE, 0, 0});
+      const size_t round = arrivals.size() - 1;
+      const auto& previous = arrivals[round - 1];
+      auto& current = arrivals[round];
+      auto& labels = rounds.labels[round];
+
+      for (const uint32_t route_id : queued_routes) {
+        const TransitRoute& route = routes_[route_id];
+        // Boarding position where the previous round gives the earliest
+        // arrival along the route
+        uint32_t board_position = NO_POSITION;
+        double board_key = UNREACHED;
+        for (uint32_t position = first_positions[route_id];
+             position < route.stops.size(); ++position) {
+          const VertexId stop = route.stops[position];
+          if (board_position != NO_POSITION) {
+            const double candidate =
+              previous[route.stops[board_position]] + wait_time_ +
+              RideTime(route, board_position, position);
+            if (candidate < current[stop] &&
+                (target >= stop_count_ || candidate < current[target])) {
+              current[stop] = candidate;
+              labels[stop] = Label{route_id, board_position, position};
+              if (!is_marked[stop]) {
+                is_marked[stop] = true;
+                marked_stops.push_back(stop);
+              }
+            }
+          }
+          if (previous[stop] != UNREACHED) {
+            const double key = previous[stop] - route.meters[position] /
+                                                velocity_;
+            if (board_position == NO_POSITION || key < board_key) {
+              board_position = position;
+              board_key = key;
+            }
+          }
+        }
+        first_positions[route_id] = NO_POSITION;
+      }
+      queued_routes.clear();
+    }
+    return rounds;
+  }
+
+  std::optional<double>
+  RaptorRouter::FindJourney(VertexId from, VertexId to,
+                            std::vector<Ride>& rides) const {
+    rides.clear();
+    const Rounds rounds = RunRounds(from, to);
+    const auto& labels = rounds.labels;
+    const double total_time = rounds.arrivals.back()[to];
+    if (total_time == UNREACHED) {
+      return std::nullopt;
+    }
+
+    // Back from the target: a stop labeled in round k was boarded at
+    // a stop reached in one of the earlier rounds
+    VertexId stop = to;
+    size_t round = labels.size() - 1;
+    while (true) {
+      while (round > 0 && labels[round][stop].route == NO_ROUTE) {
+        --round;
+      }
+      if (round == 0) {
+        break;
+      }
+      const Label& label = labels[round][stop];
+      const TransitRoute& route = routes_[label.route];
+      const VertexId board_stop = route.stops[label.board_position];
+      rides.push_back(Ride{label.route, board_stop, stop,
+                           label.alight_position - label.board_position,
+                           RideTime(route, label.board_position,
+                                    label.alight_position)});
+      stop = board_stop;
+      --round;
+    }
+    std::reverse(rides.begin(), rides.end());
+
+    return total_time;
+  }
+
+  std::vector<std::optional<double>> RaptorRouter::FindJourneyTimes(
+      VertexId from, const std::vector<VertexId>& targets) const {
+    const Rounds rounds = RunRounds(from, stop_count_);
+    std::vector<std::optional<double>> times;
+    times.reserve(targets.size());
+    for (const VertexId to : targets) {
+      const double time = rounds.arrivals.back()[to];
+      if (time == UNREACHED) {
+        times.push_back(std::nullopt);
+      }
+      else {
+        times.push_back(time);
+      }
+    }
+    return times;
+  }
+
+}  // namespace Graph